@@ -0,0 +1,106 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+/* Minimal reader for the shared memory bar export, prints the left channel
+ * as a row of characters. Not part of the plugin build:
+ *
+ *   g++ -std=c++11 -O2 -I../src/util/audio shm_reader.cpp -o shm_reader -lrt
+ *   ./shm_reader /spectralizer-Spectralizer
+ *
+ * Unless a name is set in the source properties, the segment is named after
+ * the source, with anything but letters, digits, '-' and '.' replaced by '_'.
+ *
+ * The bars are read straight from the mapping, nothing is copied out except
+ * the values the reader computes from them */
+
+#include "bar_export.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static const bar_export_header *map_segment(const char *name, size_t &size)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(bar_export_header))) {
+        size = st.st_size;
+        map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    return map == MAP_FAILED ? nullptr : static_cast<const bar_export_header *>(map);
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = argc > 1 ? argv[1] : "/spectralizer-Spectralizer";
+    const char *levels = " .:-=+*#%@";
+    const bar_export_header *header = nullptr;
+    size_t size = 0;
+    uint32_t last = 0;
+    char line[512];
+
+    for (;;) {
+        /* (Re)open once the source starts exporting */
+        if (!header || header->magic != BAR_EXPORT_MAGIC) {
+            if (header)
+                munmap(const_cast<bar_export_header *>(header), size);
+            header = map_segment(name, size);
+            if (!header || header->magic != BAR_EXPORT_MAGIC || header->version != BAR_EXPORT_VERSION) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                continue;
+            }
+        }
+
+        uint32_t begin = header->sequence.load(std::memory_order_acquire);
+        if (begin & 1 || begin == last) {
+            /* Being written or nothing new yet */
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+
+        uint64_t frame = header->frame;
+        uint32_t bars = header->bars;
+        if (bars > sizeof(line) - 1)
+            bars = sizeof(line) - 1;
+        float scale = header->max_height ? 9.f / header->max_height : 0.f;
+        const float *left = bar_export_heights(header, 0);
+        for (uint32_t i = 0; i < bars; i++) {
+            int level = static_cast<int>(left[i] * scale);
+            line[i] = levels[level < 0 ? 0 : level > 9 ? 9 : level];
+        }
+        line[bars] = '\0';
+
+        /* Everything read above is only valid if no write started in the meantime */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->sequence.load(std::memory_order_relaxed) != begin)
+            continue;
+
+        last = begin;
+        printf("\r%8llu %s", static_cast<unsigned long long>(frame), line);
+        fflush(stdout);
+    }
+}
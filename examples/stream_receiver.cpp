@@ -0,0 +1,108 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+/* Minimal receiver for the bar stream, prints the left channel as a row of
+ * characters and how many bytes each frame took. Not part of the plugin build:
+ *
+ *   g++ -std=c++11 -O2 -I../src/util/audio stream_receiver.cpp -o stream_receiver
+ *   ./stream_receiver 7878                 (udp, the default address)
+ *   ./stream_receiver /tmp/spectralizer    (unix domain socket)
+ *
+ * Frames of several sources sending to the same address are told apart by
+ * their stream id, each one is decoded on its own */
+
+#include "bar_stream.hpp"
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int bind_socket(const char *address)
+{
+    int fd;
+    if (address[0] == '/') {
+        struct sockaddr_un un = {};
+        un.sun_family = AF_UNIX;
+        strncpy(un.sun_path, address, sizeof(un.sun_path) - 1);
+        unlink(address);
+        fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (fd >= 0 && bind(fd, reinterpret_cast<sockaddr *>(&un), sizeof(un)) == 0)
+            return fd;
+    } else {
+        struct sockaddr_in in = {};
+        in.sin_family = AF_INET;
+        in.sin_port = htons(static_cast<uint16_t>(atoi(address)));
+        in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd >= 0 && bind(fd, reinterpret_cast<sockaddr *>(&in), sizeof(in)) == 0)
+            return fd;
+    }
+    perror("bind");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int fd = bind_socket(argc > 1 ? argv[1] : "7878");
+    const char *levels = " .:-=+*#%@";
+    std::vector<uint8_t> packet(65536);
+    bar_stream_header header;
+    char line[512];
+
+    /* Deltas only apply on top of the frame of the same stream right before them */
+    struct stream_state {
+        std::vector<uint16_t> values;
+        uint32_t last = 0;
+        bool synced = false;
+    };
+    std::map<uint32_t, stream_state> streams;
+
+    for (;;) {
+        ssize_t size = recv(fd, packet.data(), packet.size(), 0);
+        if (size < 0)
+            return 1;
+
+        if (size < static_cast<ssize_t>(sizeof(header)))
+            continue;
+        memcpy(&header, packet.data(), sizeof(header));
+        stream_state &state = streams[header.stream];
+        bool delta = header.flags & BSF_DELTA;
+        if (delta && !state.synced)
+            continue;
+        state.synced = bar_stream_decode(packet.data(), size, header.stream, state.last, header, state.values);
+        if (!state.synced) {
+            fprintf(stderr, "\nLost a frame of stream %08x, waiting for the next key frame\n", header.stream);
+            continue;
+        }
+        state.last = header.sequence;
+        const std::vector<uint16_t> &values = state.values;
+
+        const float full = header.flags & BSF_WIDE ? 65535.f : 255.f;
+        size_t bars = header.bars < sizeof(line) - 1 ? header.bars : sizeof(line) - 1;
+        for (size_t i = 0; i < bars; i++)
+            line[i] = levels[static_cast<int>(values[i] / full * 9.f + 0.5f)];
+        line[bars] = '\0';
+        printf("\r%08x %8u %c %5zd bytes %s", header.stream, header.sequence, delta ? 'd' : 'k', size, line);
+        fflush(stdout);
+    }
+}
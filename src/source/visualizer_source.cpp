@@ -19,14 +19,31 @@
 #include "visualizer_source.hpp"
 #include "../util/audio/bar_visualizer.hpp"
 #include "../util/audio/circle_bar_visualizer.hpp"
+#include "../util/audio/meter_visualizer.hpp"
+#include "../util/audio/scope_visualizer.hpp"
+#include "../util/audio/spectrogram_visualizer.hpp"
+#include "../util/audio/vectorscope_visualizer.hpp"
 #include "../util/audio/wire_visualizer.hpp"
 #include "../util/util.hpp"
+#include <cctype>
 
 namespace source {
 
 static auto fifo_filter = "Fifo file(*.fifo);;"
                           "All Files (*.*)";
 
+/* Every source needs its own segment, so an empty name is derived from the source name.
+ * Kept within the 31 characters macOS allows */
+static std::string shm_segment_name(obs_source_t *source, const char *name)
+{
+    if (name && *name)
+        return name;
+    std::string result = "/spectralizer-";
+    for (const char *c = obs_source_get_name(source); c && *c && result.size() < 31; c++)
+        result += isalnum(static_cast<unsigned char>(*c)) || *c == '-' || *c == '.' ? *c : '_';
+    return result;
+}
+
 struct enum_data {
     visualizer_source *vis;
     obs_property *list;
@@ -36,89 +53,209 @@ visualizer_source::visualizer_source(obs_source_t *source, obs_data_t *settings)
 {
     m_config.settings = settings;
     m_config.source = source;
+    m_analysis.run = analyze;
+    m_analysis.data = this;
 
+    /* Applied by the first tick, so the visualizer is only ever laid out on the video
+     * thread. Render draws nothing until then */
     update(settings);
 }
 
 visualizer_source::~visualizer_source()
 {
-    m_config.value_mutex.lock();
+    audio::task_pool::instance().wait(m_analysis);
+    if (m_cache) {
+        obs_enter_graphics();
+        gs_texrender_destroy(m_cache);
+        obs_leave_graphics();
+    }
+    delete m_pending.exchange(nullptr);
     delete m_visualizer;
     m_visualizer = nullptr;
-
-    if (m_config.buffer) {
-        bfree(m_config.buffer);
-        m_config.buffer = nullptr;
-    }
-    m_config.value_mutex.unlock();
 }
 
 void visualizer_source::update(obs_data_t *settings)
 {
-    visual_mode old_mode = m_config.visual;
-    std::lock_guard<std::mutex> lock(m_config.value_mutex);
-
-    m_config.audio_source_name = obs_data_get_string(settings, S_AUDIO_SOURCE);
-    m_config.sample_rate = obs_data_get_int(settings, S_SAMPLE_RATE);
-    m_config.sample_size = m_config.sample_rate / m_config.fps;
-    m_config.visual = (visual_mode)(obs_data_get_int(settings, S_SOURCE_MODE));
-    m_config.stereo = obs_data_get_bool(settings, S_STEREO);
-    m_config.stereo_space = obs_data_get_int(settings, S_STEREO_SPACE);
-    m_config.color = obs_data_get_int(settings, S_COLOR);
-    m_config.bar_width = obs_data_get_int(settings, S_BAR_WIDTH);
-    m_config.bar_space = obs_data_get_int(settings, S_BAR_SPACE);
-    m_config.detail = obs_data_get_int(settings, S_DETAIL);
-    m_config.fifo_path = obs_data_get_string(settings, S_FIFO_PATH);
-    m_config.bar_height = obs_data_get_int(settings, S_BAR_HEIGHT);
-    m_config.smoothing = (smooting_mode)obs_data_get_int(settings, S_FILTER_MODE);
-    m_config.sgs_passes = obs_data_get_int(settings, S_SGS_PASSES);
-    m_config.sgs_points = obs_data_get_int(settings, S_SGS_POINTS);
-    m_config.falloff_weight = obs_data_get_double(settings, S_FALLOFF);
-    m_config.gravity = obs_data_get_double(settings, S_GRAVITY);
-    m_config.mcat_smoothing_factor = obs_data_get_double(settings, S_FILTER_STRENGTH);
-    m_config.cx = UTIL_MAX(m_config.detail * (m_config.bar_width + m_config.bar_space) - m_config.bar_space, 10);
-    m_config.cy = UTIL_MAX(m_config.bar_height + (m_config.stereo ? m_config.stereo_space : 0), 10);
-    m_config.use_auto_scale = obs_data_get_bool(settings, S_AUTO_SCALE);
-    m_config.scale_boost = obs_data_get_double(settings, S_SCALE_BOOST);
-    m_config.scale_size = obs_data_get_double(settings, S_SCALE_SIZE);
-    m_config.wire_mode = (wire_mode)obs_data_get_int(settings, S_WIRE_MODE);
-    m_config.wire_thickness = obs_data_get_int(settings, S_WIRE_THICKNESS);
-    m_config.log_freq_scale = obs_data_get_bool(settings, S_LOG_FREQ_SCALE);
-    m_config.log_freq_quality = (log_freq_qual)obs_data_get_int(settings, S_LOG_FREQ_SCALE_QUALITY);
-    m_config.log_freq_start = obs_data_get_double(settings, S_LOG_FREQ_SCALE_START);
-    m_config.log_freq_use_hpf = obs_data_get_bool(settings, S_LOG_FREQ_SCALE_USE_HPF);
-    m_config.log_freq_hpf_curve = obs_data_get_double(settings, S_LOG_FREQ_SCALE_HPF_CURVE);
-    m_config.rounded_corners = obs_data_get_bool(settings, S_CORNER_ROUNDING);
-    m_config.corner_radius = obs_data_get_double(settings, S_CORNER_RADIUS) / 100.f;
-    m_config.corner_points = obs_data_get_int(settings, S_CORNER_POINTS);
-
-    m_config.offset = obs_data_get_double(settings, S_OFFSET) / 180.f * M_PI;
-    m_config.padding = obs_data_get_double(settings, S_PADDING) / 100.f; // to %
+    auto *c = new config_values;
+
+    c->audio_source_name = obs_data_get_string(settings, S_AUDIO_SOURCE);
+    c->sync_to_video = obs_data_get_bool(settings, S_SYNC_TO_VIDEO);
+    c->sync_lookahead = obs_data_get_int(settings, S_SYNC_LOOKAHEAD);
+    c->downmix = (downmix_mode)obs_data_get_int(settings, S_DOWNMIX);
+    c->downmix_left = obs_data_get_int(settings, S_DOWNMIX_LEFT) - 1;
+    c->downmix_right = obs_data_get_int(settings, S_DOWNMIX_RIGHT) - 1;
+    c->fifo_sample_rate = obs_data_get_int(settings, S_SAMPLE_RATE);
+    c->visual = (visual_mode)(obs_data_get_int(settings, S_SOURCE_MODE));
+    c->stereo = obs_data_get_bool(settings, S_STEREO);
+    c->mid_side = obs_data_get_bool(settings, S_MID_SIDE);
+    c->stereo_space = obs_data_get_int(settings, S_STEREO_SPACE);
+    c->color = obs_data_get_int(settings, S_COLOR);
+    c->bar_width = obs_data_get_int(settings, S_BAR_WIDTH);
+    c->bar_space = obs_data_get_int(settings, S_BAR_SPACE);
+    c->detail = obs_data_get_int(settings, S_DETAIL);
+    c->fifo_path = obs_data_get_string(settings, S_FIFO_PATH);
+    c->bar_height = obs_data_get_int(settings, S_BAR_HEIGHT);
+    c->smoothing = (smooting_mode)obs_data_get_int(settings, S_FILTER_MODE);
+    c->sgs_passes = obs_data_get_int(settings, S_SGS_PASSES);
+    c->sgs_points = obs_data_get_int(settings, S_SGS_POINTS);
+    c->falloff_weight = obs_data_get_double(settings, S_FALLOFF);
+    c->gravity = obs_data_get_double(settings, S_GRAVITY);
+    c->mcat_smoothing_factor = obs_data_get_double(settings, S_FILTER_STRENGTH);
+    c->use_auto_scale = obs_data_get_bool(settings, S_AUTO_SCALE);
+    c->scale_boost = obs_data_get_double(settings, S_SCALE_BOOST);
+    c->scale_size = obs_data_get_double(settings, S_SCALE_SIZE);
+    c->wire_mode = (wire_mode)obs_data_get_int(settings, S_WIRE_MODE);
+    c->wire_thickness = obs_data_get_int(settings, S_WIRE_THICKNESS);
+    c->spectrogram_history = obs_data_get_int(settings, S_SPECTROGRAM_HISTORY);
+    /* The log scale used to be a checkbox */
+    if (!obs_data_has_user_value(settings, S_FREQ_SCALE) && obs_data_get_bool(settings, S_LOG_FREQ_SCALE))
+        obs_data_set_int(settings, S_FREQ_SCALE, FS_LOG);
+    c->freq_scale = (enum freq_scale)obs_data_get_int(settings, S_FREQ_SCALE);
+    c->filter_bank_bars = obs_data_get_int(settings, S_FILTER_BANK_BARS);
+    c->high_cutoff_freq = obs_data_get_int(settings, S_HIGH_CUTOFF);
+    c->decimate = obs_data_get_bool(settings, S_DECIMATE);
+    c->gate_threshold = obs_data_get_double(settings, S_GATE_THRESHOLD);
+    c->gate_hysteresis = obs_data_get_double(settings, S_GATE_HYSTERESIS);
+    c->log_freq_quality = (log_freq_qual)obs_data_get_int(settings, S_LOG_FREQ_SCALE_QUALITY);
+    c->log_freq_start = obs_data_get_double(settings, S_LOG_FREQ_SCALE_START);
+    c->log_freq_use_hpf = obs_data_get_bool(settings, S_LOG_FREQ_SCALE_USE_HPF);
+    c->log_freq_hpf_curve = obs_data_get_double(settings, S_LOG_FREQ_SCALE_HPF_CURVE);
+    c->rounded_corners = obs_data_get_bool(settings, S_CORNER_ROUNDING);
+    c->corner_radius = obs_data_get_double(settings, S_CORNER_RADIUS) / 100.f;
+    c->corner_points = obs_data_get_int(settings, S_CORNER_POINTS);
+    c->gpu_bars = obs_data_get_bool(settings, S_GPU_BARS);
+    c->shm_export = obs_data_get_bool(settings, S_SHM_EXPORT);
+    c->shm_name = shm_segment_name(m_config.source, obs_data_get_string(settings, S_SHM_NAME));
+    c->stream = obs_data_get_bool(settings, S_STREAM);
+    c->stream_wide = obs_data_get_bool(settings, S_STREAM_WIDE);
+    c->stream_address = obs_data_get_string(settings, S_STREAM_ADDRESS);
+
+    c->offset = obs_data_get_double(settings, S_OFFSET) / 180.f * M_PI;
+    c->padding = obs_data_get_double(settings, S_PADDING) / 100.f; // to %
 
 #ifdef LINUX
-    m_config.auto_clear = obs_data_get_bool(settings, S_AUTO_CLEAR);
+    c->auto_clear = obs_data_get_bool(settings, S_AUTO_CLEAR);
 
     struct obs_video_info ovi;
     if (obs_get_video_info(&ovi)) {
-        m_config.fps = ovi.fps_num;
+        c->fps = ovi.fps_num;
     } else {
-        m_config.fps = 30;
+        c->fps = 30;
         warn("Couldn't determine fps, mpd fifo might not work as intended!");
     }
 #endif
 
-    if (m_visualizer) /* this modifies sample size, if an internal audio source is used */
-        m_visualizer->update();
+    /* Publish the snapshot. If the video thread didn't pick up the previous
+     * one yet, it never will, so it can be freed here */
+    delete m_pending.exchange(c);
+}
 
-    if (m_config.buffer)
-        bfree(m_config.buffer);
+/* Which settings groups differ between the two snapshots */
+static uint32_t diff(const config_values &a, const config_values &b)
+{
+    uint32_t dirty = DIRTY_NONE;
+#define DIFF(field, group)                                                                                             \
+    if (a.field != b.field)                                                                                            \
+    dirty |= group
+
+    /* Audio source */
+    DIFF(audio_source_name, DIRTY_AUDIO);
+    DIFF(sync_to_video, DIRTY_AUDIO);
+    DIFF(sync_lookahead, DIRTY_AUDIO);
+    DIFF(downmix, DIRTY_AUDIO);
+    DIFF(downmix_left, DIRTY_AUDIO);
+    DIFF(downmix_right, DIRTY_AUDIO);
+    DIFF(fifo_sample_rate, DIRTY_AUDIO);
+    DIFF(fifo_path, DIRTY_AUDIO);
+    DIFF(auto_clear, DIRTY_AUDIO);
+    DIFF(fps, DIRTY_AUDIO);
+
+    /* Fft layout */
+    DIFF(stereo, DIRTY_FFT);
+    DIFF(mid_side, DIRTY_FFT);
+    DIFF(decimate, DIRTY_FFT);
+
+    /* Bin to bar mapping */
+    DIFF(detail, DIRTY_BARS);
+    DIFF(smoothing, DIRTY_BARS);
+    DIFF(sgs_passes, DIRTY_BARS);
+    DIFF(sgs_points, DIRTY_BARS);
+    DIFF(mcat_smoothing_factor, DIRTY_BARS);
+    DIFF(use_auto_scale, DIRTY_BARS);
+    DIFF(freq_scale, DIRTY_BARS);
+    DIFF(filter_bank_bars, DIRTY_BARS);
+    DIFF(high_cutoff_freq, DIRTY_BARS);
+    DIFF(log_freq_quality, DIRTY_BARS);
+    DIFF(log_freq_start, DIRTY_BARS);
+    DIFF(log_freq_use_hpf, DIRTY_BARS);
+    DIFF(log_freq_hpf_curve, DIRTY_BARS);
+
+    /* Geometry */
+    DIFF(stereo_space, DIRTY_GEOMETRY);
+    DIFF(bar_width, DIRTY_GEOMETRY);
+    DIFF(bar_space, DIRTY_GEOMETRY);
+    DIFF(bar_height, DIRTY_GEOMETRY);
+    DIFF(wire_mode, DIRTY_GEOMETRY);
+    DIFF(wire_thickness, DIRTY_GEOMETRY);
+    DIFF(spectrogram_history, DIRTY_GEOMETRY);
+    DIFF(rounded_corners, DIRTY_GEOMETRY);
+    DIFF(corner_radius, DIRTY_GEOMETRY);
+    DIFF(corner_points, DIRTY_GEOMETRY);
+    DIFF(gpu_bars, DIRTY_GEOMETRY);
+    DIFF(offset, DIRTY_GEOMETRY);
+    DIFF(padding, DIRTY_GEOMETRY);
+
+    /* Values that are used as they are every frame */
+    DIFF(color, DIRTY_COLOR);
+    DIFF(falloff_weight, DIRTY_COLOR);
+    DIFF(gravity, DIRTY_COLOR);
+    DIFF(scale_boost, DIRTY_COLOR);
+    DIFF(scale_size, DIRTY_COLOR);
+    DIFF(gate_threshold, DIRTY_COLOR);
+    DIFF(gate_hysteresis, DIRTY_COLOR);
+    DIFF(shm_export, DIRTY_COLOR);
+    DIFF(shm_name, DIRTY_COLOR);
+    DIFF(stream, DIRTY_COLOR);
+    DIFF(stream_wide, DIRTY_COLOR);
+    DIFF(stream_address, DIRTY_COLOR);
+#undef DIFF
+    return dirty;
+}
 
-    m_config.buffer = static_cast<pcm_stereo_sample *>(bzalloc(m_config.sample_size * sizeof(pcm_stereo_sample)));
+void visualizer_source::apply_pending()
+{
+    config_values *values = m_pending.exchange(nullptr);
+    if (values) {
+        apply(*values);
+        /* The snapshot was only ever seen by this thread, so it's safe to free now */
+        delete values;
+    }
+}
+
+void visualizer_source::apply(const config_values &values)
+{
+    auto &c = m_config;
+    uint32_t dirty = m_visualizer ? diff(c, values) : DIRTY_ALL;
+    visual_mode old_mode = c.visual;
+    if (dirty)
+        m_cache_valid = false;
+
+    static_cast<config_values &>(c) = values;
+
+    /* Circle visualizers override the size in their update */
+    c.cx = UTIL_MAX(c.detail * (c.bar_width + c.bar_space) - c.bar_space, 10);
+    c.cy = UTIL_MAX(c.bar_height + (c.stereo ? c.stereo_space : 0), 10);
+
+    if (dirty & DIRTY_AUDIO) {
+        /* The internal audio source overrides this with the obs output settings */
+        c.sample_rate = c.fifo_sample_rate;
+        c.sample_size = c.sample_rate / c.fps;
+    }
 
-    if (old_mode != m_config.visual || !m_visualizer) {
+    if (old_mode != c.visual || !m_visualizer) {
         delete m_visualizer;
 
-        switch (m_config.visual) {
+        switch (c.visual) {
         case VM_BARS:
             m_visualizer = new audio::bar_visualizer(&m_config);
             break;
@@ -127,26 +264,99 @@ void visualizer_source::update(obs_data_t *settings)
             break;
         case VM_CIRCULAR_BARS:
             m_visualizer = new audio::circle_bar_visualizer(&m_config);
+            break;
+        case VM_SPECTROGRAM:
+            m_visualizer = new audio::spectrogram_visualizer(&m_config);
+            break;
+        case VM_SCOPE:
+            m_visualizer = new audio::scope_visualizer(&m_config);
+            break;
+        case VM_VECTORSCOPE:
+            m_visualizer = new audio::vectorscope_visualizer(&m_config);
+            break;
+        case VM_METER:
+            m_visualizer = new audio::meter_visualizer(&m_config);
         }
-        m_visualizer->update();
+        dirty = DIRTY_ALL;
     }
+
+    /* this modifies sample size, if an internal audio source is used,
+     * and places the pcm buffer in the arena of the visualizer */
+    m_visualizer->update(dirty);
+}
+
+void visualizer_source::analyze(void *data)
+{
+    auto *vis = reinterpret_cast<visualizer_source *>(data);
+    vis->m_visualizer->tick(vis->m_tick_seconds);
 }
 
 void visualizer_source::tick(float seconds)
 {
-    m_config.value_mutex.lock();
+    /* If the source wasn't rendered, the last analysis might still be running */
+    auto &pool = audio::task_pool::instance();
+    pool.wait(m_analysis);
+    apply_pending();
 
-    if (m_visualizer)
-        m_visualizer->tick(seconds);
+    if (m_visualizer) {
+        m_tick_seconds = seconds;
+        pool.submit(m_analysis);
+    }
 
-    m_config.value_mutex.unlock();
+    m_config.health.maybe_warn(obs_source_get_name(m_config.source));
+#ifdef SPECTRALIZER_PROFILER
+    m_config.profiler.maybe_log(obs_source_get_name(m_config.source));
+#endif
 }
 
 void visualizer_source::render(gs_effect_t *effect)
 {
     UNUSED_PARAMETER(effect);
-    if (m_visualizer) {
-        m_config.value_mutex.lock();
+    audio::task_pool::instance().wait(m_analysis);
+    if (!m_visualizer)
+        return;
+
+    /* Also true if the source is shown in more than one view, only the first one redraws */
+    bool changed = m_visualizer->output_changed() || !m_cache_valid;
+    if (!m_cache)
+        m_cache = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+    if (changed) {
+        gs_texrender_reset(m_cache);
+        if (!gs_texrender_begin(m_cache, m_config.cx, m_config.cy)) {
+            m_cache_valid = false;
+            draw_visualizer();
+            return;
+        }
+
+        struct vec4 clear;
+        vec4_zero(&clear);
+        gs_clear(GS_CLEAR_COLOR, &clear, 0.f, 0);
+        gs_ortho(0.f, m_config.cx, 0.f, m_config.cy, -100.f, 100.f);
+
+        /* The texture keeps the color and alpha as drawn, it's blended once it's drawn itself */
+        gs_blend_state_push();
+        gs_enable_blending(false);
+        draw_visualizer();
+        gs_blend_state_pop();
+
+        gs_texrender_end(m_cache);
+        m_cache_valid = true;
+    }
+
+    gs_texture_t *frame = gs_texrender_get_texture(m_cache);
+    gs_effect_t *draw = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+    gs_effect_set_texture(gs_effect_get_param_by_name(draw, "image"), frame);
+    while (gs_effect_loop(draw, "Draw"))
+        gs_draw_sprite(frame, 0, m_config.cx, m_config.cy);
+}
+
+void visualizer_source::draw_visualizer()
+{
+    if (m_visualizer->own_effect()) {
+        PROFILE_SCOPE(m_config.profiler, stats::ST_RENDER);
+        m_visualizer->render(nullptr);
+    } else {
         gs_effect_t *solid = obs_get_base_effect(OBS_EFFECT_SOLID);
         gs_eparam_t *color = gs_effect_get_param_by_name(solid, "color");
         gs_technique_t *tech = gs_effect_get_technique(solid, "Solid");
@@ -158,14 +368,55 @@ void visualizer_source::render(gs_effect_t *effect)
         gs_technique_begin(tech);
         gs_technique_begin_pass(tech, 0);
 
-        m_visualizer->render(solid);
+        {
+            PROFILE_SCOPE(m_config.profiler, stats::ST_RENDER);
+            m_visualizer->render(solid);
+        }
 
         gs_technique_end_pass(tech);
         gs_technique_end(tech);
-        m_config.value_mutex.unlock();
     }
 }
 
+void visualizer_source::write_stats()
+{
+    std::string text;
+    /* Called from the ui thread, both only read atomics */
+    m_config.health.format(text);
+#ifdef SPECTRALIZER_PROFILER
+    m_config.profiler.format(text);
+#endif
+    obs_data_set_string(m_config.settings, S_STATS, text.c_str());
+}
+
+static bool refresh_stats(obs_properties_t *, obs_property_t *, void *data)
+{
+    reinterpret_cast<visualizer_source *>(data)->write_stats();
+    return true;
+}
+
+static bool show_stats_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
+{
+    bool show = obs_data_get_bool(data, S_STATS_SHOW);
+    obs_property_set_visible(obs_properties_get(props, S_STATS), show);
+    obs_property_set_visible(obs_properties_get(props, S_STATS_REFRESH), show);
+    return true;
+}
+
+static bool shm_export_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
+{
+    obs_property_set_visible(obs_properties_get(props, S_SHM_NAME), obs_data_get_bool(data, S_SHM_EXPORT));
+    return true;
+}
+
+static bool stream_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
+{
+    bool stream = obs_data_get_bool(data, S_STREAM);
+    obs_property_set_visible(obs_properties_get(props, S_STREAM_ADDRESS), stream);
+    obs_property_set_visible(obs_properties_get(props, S_STREAM_WIDE), stream);
+    return true;
+}
+
 static bool filter_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
 {
     int mode = obs_data_get_int(data, S_FILTER_MODE);
@@ -217,11 +468,29 @@ static bool source_changed(obs_properties_t *props, obs_property_t *, obs_data_t
     return true;
 }
 
+static bool sync_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
+{
+    auto sync = obs_data_get_bool(data, S_SYNC_TO_VIDEO);
+    auto *lookahead = obs_properties_get(props, S_SYNC_LOOKAHEAD);
+    obs_property_set_visible(lookahead, sync);
+    return true;
+}
+
+static bool downmix_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
+{
+    bool pick = obs_data_get_int(data, S_DOWNMIX) == DM_CHANNELS;
+    obs_property_set_visible(obs_properties_get(props, S_DOWNMIX_LEFT), pick);
+    obs_property_set_visible(obs_properties_get(props, S_DOWNMIX_RIGHT), pick);
+    return true;
+}
+
 static bool stereo_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
 {
     auto stereo = obs_data_get_bool(data, S_STEREO);
     auto *space = obs_properties_get(props, S_STEREO_SPACE);
+    auto *mid_side = obs_properties_get(props, S_MID_SIDE);
     obs_property_set_visible(space, stereo);
+    obs_property_set_visible(mid_side, stereo);
     return true;
 }
 
@@ -234,8 +503,13 @@ static bool visual_mode_changed(obs_properties_t *props, obs_property_t *, obs_d
     auto *space = obs_properties_get(props, S_BAR_SPACE);
     auto *offset = obs_properties_get(props, S_OFFSET);
     auto *padding = obs_properties_get(props, S_PADDING);
+    auto *gpu_bars = obs_properties_get(props, S_GPU_BARS);
+    auto *history = obs_properties_get(props, S_SPECTROGRAM_HISTORY);
 
-    obs_property_set_visible(width, vm != VM_WIRE);
+    obs_property_set_visible(width, vm != VM_WIRE && vm != VM_SPECTROGRAM);
+    obs_property_set_visible(space, vm != VM_SPECTROGRAM);
+    obs_property_set_visible(history, vm == VM_SPECTROGRAM);
+    obs_property_set_visible(gpu_bars, vm == VM_BARS);
     obs_property_set_description(space, vm == VM_WIRE ? T_WIRE_SPACING : T_BAR_SPACING);
     obs_property_set_description(height, vm == VM_WIRE ? T_WIRE_HEIGHT : T_BAR_HEIGHT);
     obs_property_set_visible(wire_mode, vm == VM_WIRE);
@@ -249,13 +523,14 @@ static bool wire_mode_changed(obs_properties_t *props, obs_property_t *, obs_dat
 {
     wire_mode wm = (wire_mode)obs_data_get_int(data, S_WIRE_MODE);
     auto *wire_thickness = obs_properties_get(props, S_WIRE_THICKNESS);
-    obs_property_set_visible(wire_thickness, wm == WM_THICK);
+    obs_property_set_visible(wire_thickness, wm == WM_THICK || wm == WM_SMOOTH);
     return true;
 }
 
-static bool log_freq_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
+static bool freq_scale_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
 {
-    bool log_freq_enabled = obs_data_get_bool(data, S_LOG_FREQ_SCALE);
+    int scale = obs_data_get_int(data, S_FREQ_SCALE);
+    bool log_freq_enabled = scale == FS_LOG;
     bool log_freq_hpf_enabled = obs_data_get_bool(data, S_LOG_FREQ_SCALE_USE_HPF);
     //auto *log_freq_quality = obs_properties_get(props, S_LOG_FREQ_SCALE_QUALITY);
     auto *log_freq_start = obs_properties_get(props, S_LOG_FREQ_SCALE_START);
@@ -264,7 +539,7 @@ static bool log_freq_changed(obs_properties_t *props, obs_property_t *, obs_data
 
     // FIXME look below in get_properties_for_visualizer()
     //obs_property_set_visible(log_freq_quality, log_freq_enabled);
-    obs_property_set_visible(log_freq_start, log_freq_enabled);
+    obs_property_set_visible(log_freq_start, scale != FS_LIN); /* Lowest bar of the constant-Q scale too */
     obs_property_set_visible(log_freq_use_hpf, log_freq_enabled);
     obs_property_set_visible(log_freq_hpf_curve, log_freq_enabled && log_freq_hpf_enabled);
     return true;
@@ -272,7 +547,7 @@ static bool log_freq_changed(obs_properties_t *props, obs_property_t *, obs_data
 
 static bool log_freq_use_hpf_changed(obs_properties_t *props, obs_property_t *, obs_data_t *data)
 {
-    bool log_freq_enabled = obs_data_get_bool(data, S_LOG_FREQ_SCALE);
+    bool log_freq_enabled = obs_data_get_int(data, S_FREQ_SCALE) == FS_LOG;
     bool log_freq_hpf_enabled = obs_data_get_bool(data, S_LOG_FREQ_SCALE_USE_HPF);
     auto *log_freq_hpf_curve = obs_properties_get(props, S_LOG_FREQ_SCALE_HPF_CURVE);
 
@@ -313,6 +588,10 @@ obs_properties_t *get_properties_for_visualiser(void *data)
     obs_property_list_add_int(mode, T_MODE_BARS, (int)VM_BARS);
     obs_property_list_add_int(mode, T_MODE_CIRCLE_BARS, (int)VM_CIRCULAR_BARS);
     obs_property_list_add_int(mode, T_MODE_WIRE, (int)VM_WIRE);
+    obs_property_list_add_int(mode, T_MODE_SPECTROGRAM, (int)VM_SPECTROGRAM);
+    obs_property_list_add_int(mode, T_MODE_SCOPE, (int)VM_SCOPE);
+    obs_property_list_add_int(mode, T_MODE_VECTORSCOPE, (int)VM_VECTORSCOPE);
+    obs_property_list_add_int(mode, T_MODE_METER, (int)VM_METER);
     obs_property_set_modified_callback(mode, visual_mode_changed);
 
     auto *src =
@@ -323,6 +602,25 @@ obs_properties_t *get_properties_for_visualiser(void *data)
     obs_property_set_modified_callback(filter, filter_changed);
     obs_property_set_modified_callback(src, source_changed);
 
+    /* Only used for internal audio sources, mpd doesn't provide timestamps */
+    auto *sync = obs_properties_add_bool(props, S_SYNC_TO_VIDEO, T_SYNC_TO_VIDEO);
+    auto *lookahead = obs_properties_add_int(props, S_SYNC_LOOKAHEAD, T_SYNC_LOOKAHEAD, 0, 1000, 1);
+    obs_property_int_set_suffix(lookahead, " ms");
+    obs_property_set_visible(lookahead, false);
+    obs_property_set_modified_callback(sync, sync_changed);
+
+    auto *downmix =
+        obs_properties_add_list(props, S_DOWNMIX, T_DOWNMIX, OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+    obs_property_list_add_int(downmix, T_DOWNMIX_STEREO, DM_STEREO);
+    obs_property_list_add_int(downmix, T_DOWNMIX_SUM_ALL, DM_SUM_ALL);
+    obs_property_list_add_int(downmix, T_DOWNMIX_LFE, DM_LFE);
+    obs_property_list_add_int(downmix, T_DOWNMIX_CHANNELS, DM_CHANNELS);
+    obs_property_set_modified_callback(downmix, downmix_changed);
+    obs_property_set_visible(obs_properties_add_int(props, S_DOWNMIX_LEFT, T_DOWNMIX_LEFT, 1, MAX_AUDIO_CHANNELS, 1),
+                             false);
+    obs_property_set_visible(obs_properties_add_int(props, S_DOWNMIX_RIGHT, T_DOWNMIX_RIGHT, 1, MAX_AUDIO_CHANNELS, 1),
+                             false);
+
     obs_property_list_add_int(filter, T_FILTER_NONE, (int)SM_NONE);
     obs_property_list_add_int(filter, T_FILTER_MONSTERCAT, (int)SM_MONSTERCAT);
     obs_property_list_add_int(filter, T_FILTER_SGS, (int)SM_SGS);
@@ -348,6 +646,7 @@ obs_properties_t *get_properties_for_visualiser(void *data)
     obs_property_int_set_suffix(h, " Pixel");
     obs_property_int_set_suffix(s, " Pixel");
     obs_property_float_set_suffix(radius, "%");
+    obs_properties_add_bool(props, S_GPU_BARS, T_GPU_BARS);
 
     obs_property_set_visible(sr, false); /* Sample rate is only needed for fifo */
     obs_property_set_visible(points, false);
@@ -372,10 +671,16 @@ obs_properties_t *get_properties_for_visualiser(void *data)
     obs_property_list_add_int(wm, T_WIRE_MODE_THICK, WM_THICK);
     obs_property_list_add_int(wm, T_WIRE_MODE_FILL, WM_FILL);
     obs_property_list_add_int(wm, T_WIRE_MODE_FILL_INVERTED, WM_FILL_INVERTED);
+    obs_property_list_add_int(wm, T_WIRE_MODE_SMOOTH, WM_SMOOTH);
     obs_property_set_visible(wm, false);
     obs_property_set_visible(th, false);
     obs_property_set_modified_callback(wm, wire_mode_changed);
 
+    /* Spectrogram settings */
+    auto *history = obs_properties_add_int(props, S_SPECTROGRAM_HISTORY, T_SPECTROGRAM_HISTORY, 16, 4096, 1);
+    obs_property_int_set_suffix(history, " Frames");
+    obs_property_set_visible(history, false);
+
     /* Scale stuff */
     auto auto_scale = obs_properties_add_bool(props, S_AUTO_SCALE, T_AUTO_SCALE);
     obs_property_set_modified_callback(auto_scale, use_auto_scale_changed);
@@ -384,6 +689,10 @@ obs_properties_t *get_properties_for_visualiser(void *data)
 
     /* Smoothing stuff */
     obs_properties_add_float_slider(props, S_GRAVITY, T_GRAVITY, 0, 1, 0.01);
+    auto *gate = obs_properties_add_float_slider(props, S_GATE_THRESHOLD, T_GATE_THRESHOLD, -96.0, 0.0, 0.5);
+    obs_property_float_set_suffix(gate, " dB");
+    auto *hysteresis = obs_properties_add_float_slider(props, S_GATE_HYSTERESIS, T_GATE_HYSTERESIS, 0.0, 24.0, 0.5);
+    obs_property_float_set_suffix(hysteresis, " dB");
     /* This setting doesn't really do anything, it's used in cli-visualizer to determine
      * the fallow of colors inside bins
      */
@@ -398,8 +707,16 @@ obs_properties_t *get_properties_for_visualiser(void *data)
     obs_properties_add_bool(props, S_AUTO_CLEAR, T_AUTO_CLEAR);
 #endif
 
-    auto *log_freq = obs_properties_add_bool(props, S_LOG_FREQ_SCALE, T_LOG_FREQ_SCALE);
-    obs_property_set_modified_callback(log_freq, log_freq_changed);
+    auto *freq_scale =
+        obs_properties_add_list(props, S_FREQ_SCALE, T_FREQ_SCALE, OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+    obs_property_list_add_int(freq_scale, T_FREQ_SCALE_LIN, FS_LIN);
+    obs_property_list_add_int(freq_scale, T_FREQ_SCALE_LOG, FS_LOG);
+    obs_property_list_add_int(freq_scale, T_FREQ_SCALE_CQT, FS_CQT);
+    obs_property_set_modified_callback(freq_scale, freq_scale_changed);
+
+    auto *high_cutoff = obs_properties_add_int(props, S_HIGH_CUTOFF, T_HIGH_CUTOFF, 100, 24000, 10);
+    obs_property_int_set_suffix(high_cutoff, " Hz");
+    obs_properties_add_bool(props, S_DECIMATE, T_DECIMATE);
 
     auto *log_freq_quality = obs_properties_add_list(props, S_LOG_FREQ_SCALE_QUALITY, T_LOG_FREQ_SCALE_QUAL,
                                                      OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
@@ -424,25 +741,53 @@ obs_properties_t *get_properties_for_visualiser(void *data)
     auto *log_freq_start =
         obs_properties_add_float_slider(props, S_LOG_FREQ_SCALE_START, T_LOG_FREQ_SCALE_START, 20.0, 100.0, 0.1);
     obs_property_float_set_suffix(log_freq_start, " Hz");
-    obs_property_set_visible(log_freq_start, defaults::log_freq_scale);
+    obs_property_set_visible(log_freq_start, defaults::freq_scale != FS_LIN);
 
     auto *log_freq_use_hpf = obs_properties_add_bool(props, S_LOG_FREQ_SCALE_USE_HPF, T_LOG_FREQ_SCALE_USE_HPF);
-    obs_property_set_visible(log_freq_use_hpf, defaults::log_freq_scale);
+    obs_property_set_visible(log_freq_use_hpf, defaults::freq_scale == FS_LOG);
     obs_property_set_modified_callback(log_freq_use_hpf, log_freq_use_hpf_changed);
 
     obs_property_set_visible(obs_properties_add_float_slider(props, S_LOG_FREQ_SCALE_HPF_CURVE,
                                                              T_LOG_FREQ_SCALE_HPF_CURVE, 2.0,
                                                              defaults::log_freq_hpf_curve_max, 0.1),
-                             defaults::log_freq_scale && defaults::log_freq_use_hpf);
+                             defaults::freq_scale == FS_LOG && defaults::log_freq_use_hpf);
 
     auto *stereo = obs_properties_add_bool(props, S_STEREO, T_STEREO);
     auto *space = obs_properties_add_int(props, S_STEREO_SPACE, T_STEREO_SPACE, -UINT16_MAX, UINT16_MAX, 1);
     obs_property_int_set_suffix(space, " Pixel");
+    obs_property_set_visible(obs_properties_add_bool(props, S_MID_SIDE, T_MID_SIDE), false);
     auto *dt = obs_properties_add_int(props, S_DETAIL, T_DETAIL, 1, UINT16_MAX, 1);
     obs_property_int_set_suffix(dt, " Bins");
+    auto *bank = obs_properties_add_int(props, S_FILTER_BANK_BARS, T_FILTER_BANK_BARS, 0, UINT16_MAX, 1);
+    obs_property_int_set_suffix(bank, " Bins");
     obs_property_set_visible(space, false);
     obs_property_set_modified_callback(stereo, stereo_changed);
 
+#if defined(LINUX) || defined(MACOS)
+    /* Shared memory export for external renderers, see examples/shm_reader.cpp */
+    auto *shm_export = obs_properties_add_bool(props, S_SHM_EXPORT, T_SHM_EXPORT);
+    obs_property_set_visible(obs_properties_add_text(props, S_SHM_NAME, T_SHM_NAME, OBS_TEXT_DEFAULT), false);
+    obs_property_set_modified_callback(shm_export, shm_export_changed);
+
+    /* Same bars as datagrams, for led walls and the like */
+    auto *stream = obs_properties_add_bool(props, S_STREAM, T_STREAM);
+    obs_property_set_visible(obs_properties_add_text(props, S_STREAM_ADDRESS, T_STREAM_ADDRESS, OBS_TEXT_DEFAULT),
+                             false);
+    obs_property_set_visible(obs_properties_add_bool(props, S_STREAM_WIDE, T_STREAM_WIDE), false);
+    obs_property_set_modified_callback(stream, stream_changed);
+#endif
+
+    /* Read-only, the text is filled in from the collected statistics */
+    auto *show_stats = obs_properties_add_bool(props, S_STATS_SHOW, T_STATS_SHOW);
+    auto *stats = obs_properties_add_text(props, S_STATS, T_STATS, OBS_TEXT_MULTILINE);
+    auto *refresh = obs_properties_add_button(props, S_STATS_REFRESH, T_STATS_REFRESH, refresh_stats);
+    obs_property_set_enabled(stats, false);
+    obs_property_set_visible(stats, false);
+    obs_property_set_visible(refresh, false);
+    obs_property_set_modified_callback(show_stats, show_stats_changed);
+    if (data)
+        reinterpret_cast<visualizer_source *>(data)->write_stats();
+
     enum_data d;
     d.list = src;
     d.vis = reinterpret_cast<visualizer_source *>(data);
@@ -470,6 +815,7 @@ void register_visualiser()
         obs_data_set_default_int(settings, S_COLOR, 0xFFFFFFFF);
         obs_data_set_default_int(settings, S_DETAIL, defaults::detail);
         obs_data_set_default_bool(settings, S_STEREO, defaults::stereo);
+        obs_data_set_default_bool(settings, S_MID_SIDE, false);
         obs_data_set_default_int(settings, S_SOURCE_MODE, (int)VM_BARS);
         obs_data_set_default_string(settings, S_AUDIO_SOURCE, defaults::audio_source);
         obs_data_set_default_int(settings, S_SAMPLE_RATE, defaults::sample_rate);
@@ -488,7 +834,13 @@ void register_visualiser()
         obs_data_set_default_double(settings, S_SCALE_BOOST, defaults::scale_boost);
         obs_data_set_default_int(settings, S_WIRE_MODE, defaults::wire_mode);
         obs_data_set_default_int(settings, S_WIRE_THICKNESS, defaults::wire_thickness);
-        obs_data_set_default_bool(settings, S_LOG_FREQ_SCALE, defaults::log_freq_scale);
+        obs_data_set_default_int(settings, S_SPECTROGRAM_HISTORY, defaults::spectrogram_history);
+        obs_data_set_default_int(settings, S_FREQ_SCALE, defaults::freq_scale);
+        obs_data_set_default_int(settings, S_FILTER_BANK_BARS, defaults::filter_bank_bars);
+        obs_data_set_default_int(settings, S_HIGH_CUTOFF, static_cast<int>(defaults::hfreq_cut));
+        obs_data_set_default_bool(settings, S_DECIMATE, defaults::decimate);
+        obs_data_set_default_double(settings, S_GATE_THRESHOLD, defaults::gate_threshold);
+        obs_data_set_default_double(settings, S_GATE_HYSTERESIS, defaults::gate_hysteresis);
         obs_data_set_default_int(settings, S_LOG_FREQ_SCALE_QUALITY, defaults::log_freq_quality);
         obs_data_set_default_double(settings, S_LOG_FREQ_SCALE_START, defaults::log_freq_start);
         obs_data_set_default_bool(settings, S_LOG_FREQ_SCALE_USE_HPF, defaults::log_freq_use_hpf);
@@ -496,6 +848,18 @@ void register_visualiser()
         obs_data_set_default_bool(settings, S_CORNER_ROUNDING, false);
         obs_data_set_default_int(settings, S_CORNER_POINTS, defaults::corner_points);
         obs_data_set_default_double(settings, S_CORNER_RADIUS, 0.5f);
+        obs_data_set_default_bool(settings, S_GPU_BARS, defaults::gpu_bars);
+        obs_data_set_default_bool(settings, S_STATS_SHOW, false);
+        obs_data_set_default_bool(settings, S_SHM_EXPORT, false);
+        obs_data_set_default_string(settings, S_SHM_NAME, defaults::shm_name);
+        obs_data_set_default_bool(settings, S_STREAM, false);
+        obs_data_set_default_bool(settings, S_STREAM_WIDE, false);
+        obs_data_set_default_string(settings, S_STREAM_ADDRESS, defaults::stream_address);
+        obs_data_set_default_bool(settings, S_SYNC_TO_VIDEO, defaults::sync_to_video);
+        obs_data_set_default_int(settings, S_SYNC_LOOKAHEAD, defaults::sync_lookahead);
+        obs_data_set_default_int(settings, S_DOWNMIX, defaults::downmix);
+        obs_data_set_default_int(settings, S_DOWNMIX_LEFT, 1);
+        obs_data_set_default_int(settings, S_DOWNMIX_RIGHT, 2);
     };
 
     si.update = [](void *data, obs_data_t *settings) { reinterpret_cast<visualizer_source *>(data)->update(settings); };
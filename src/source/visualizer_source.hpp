@@ -6,10 +6,12 @@
  */
 #pragma once
 
+#include "../util/audio/task_pool.hpp"
+#include "../util/stats.hpp"
 #include "../util/util.hpp"
 #include <cstdint>
 #include <map>
-#include <mutex>
+#include <atomic>
 #include <obs-module.h>
 
 namespace audio {
@@ -18,32 +20,35 @@ class audio_visualizer;
 
 namespace source {
 
-struct config {
-    std::mutex value_mutex;
-
-    /* obs source stuff */
-    obs_source_t *source = nullptr;
-    obs_data_t *settings = nullptr;
-
+/* User settings, parsed from the obs data on the ui thread and handed to
+ * the video thread as an immutable snapshot, see visualizer_source::update */
+struct config_values {
     /* Misc */
-    const char *fifo_path = defaults::fifo_path;
+    std::string fifo_path = defaults::fifo_path;
     bool auto_clear = false;
-    pcm_stereo_sample *buffer = nullptr;
 
     /* Appearance settings */
     visual_mode visual = defaults::visual;
     smooting_mode smoothing = defaults::smoothing;
     uint32_t color = defaults::color;
-    uint16_t detail = defaults::detail, cx = defaults::cx, cy = defaults::cy;
+    uint16_t detail = defaults::detail;
     uint16_t fps = defaults::fps;
 
     /* Audio settings */
-    uint32_t sample_rate = defaults::sample_rate;
-    uint32_t sample_size = defaults::sample_size;
+    uint32_t fifo_sample_rate = defaults::sample_rate; /* As set by the user, only used by the mpd fifo */
 
     std::string audio_source_name = "";
     double low_cutoff_freq = defaults::lfreq_cut;
     double high_cutoff_freq = defaults::hfreq_cut;
+    bool decimate = defaults::decimate; /* Downsample to just above high_cutoff_freq before the fft */
+
+    /* Align the analyzed audio to the video frame time */
+    bool sync_to_video = defaults::sync_to_video;
+    uint16_t sync_lookahead = defaults::sync_lookahead; /* in ms */
+
+    /* Channel mixing for internal sources */
+    downmix_mode downmix = defaults::downmix;
+    uint8_t downmix_left = 0, downmix_right = 1; /* Only used for DM_CHANNELS */
 
     /* smoothing */
     uint32_t sgs_points = defaults::sgs_points, sgs_passes = defaults::sgs_passes;
@@ -56,7 +61,8 @@ struct config {
     double mcat_smoothing_factor = defaults::mcat_smooth;
 
     /* log frequency scale */
-    bool log_freq_scale = defaults::log_freq_scale;
+    enum freq_scale freq_scale = defaults::freq_scale;
+    uint16_t filter_bank_bars = defaults::filter_bank_bars; /* Detail below which filters may replace the fft */
     log_freq_qual log_freq_quality = defaults::log_freq_quality;
     double log_freq_start = defaults::log_freq_start;
     bool log_freq_use_hpf = defaults::log_freq_use_hpf;
@@ -71,25 +77,81 @@ struct config {
     bool rounded_corners = false;
     float corner_radius = 0.5f;
     uint16_t corner_points = defaults::corner_points;
+    bool gpu_bars = defaults::gpu_bars; /* One shader quad instead of geometry per bar */
 
     /* Wire visualizer settings */
     uint16_t wire_thickness = defaults::wire_thickness;
     enum wire_mode wire_mode = defaults::wire_mode;
 
+    /* Spectrogram settings */
+    uint16_t spectrogram_history = defaults::spectrogram_history; /* Frames, one pixel column each */
+
     /* Circular visualizer settings */
-    float offset;  // in degree
-    float padding; // in %
+    float offset = 0.f;  // in degree
+    float padding = 0.f; // in %
 
     /* General spectrum settings */
     bool stereo = defaults::stereo;
+    bool mid_side = false; /* Show mid & side instead of left & right in stereo mode */
     int16_t stereo_space = 0;
     double falloff_weight = defaults::falloff_weight;
+
+    /* Silence gate, the analysis pauses below the threshold */
+    double gate_threshold = defaults::gate_threshold;   /* dBFS, opens when the peak reaches it */
+    double gate_hysteresis = defaults::gate_hysteresis; /* dB, closes when the rms falls this far below */
     double gravity = defaults::gravity;
+
+    /* Publishes the bars to other processes, see audio::bar_export */
+    bool shm_export = false;
+    std::string shm_name = defaults::shm_name;
+
+    /* Sends the bars to a socket, see audio::bar_stream */
+    bool stream = false;
+    bool stream_wide = false; /* 16 instead of 8 bit bars */
+    std::string stream_address = defaults::stream_address;
+};
+
+/* The settings in use plus the state derived from them. Only the video thread
+ * (tick and render) touches this, the audio thread only uses the atomics in health */
+struct config : config_values {
+    /* obs source stuff */
+    obs_source_t *source = nullptr;
+    obs_data_t *settings = nullptr;
+
+    pcm_stereo_sample *buffer = nullptr; /* Owned by the arena of the visualizer */
+    uint16_t cx = defaults::cx, cy = defaults::cy;
+
+    /* Set by the audio source */
+    uint32_t sample_rate = defaults::sample_rate;
+    uint32_t sample_size = defaults::sample_size;
+
+    stats::ingest_health health;
+#ifdef SPECTRALIZER_PROFILER
+    stats::profiler profiler;
+#endif
 };
 
 class visualizer_source {
     config m_config;
     audio::audio_visualizer *m_visualizer = nullptr;
+
+    /* Latest settings from update(), waiting to be picked up by the next tick.
+     * Whoever takes a snapshot out of here owns it */
+    std::atomic<config_values *> m_pending{nullptr};
+
+    /* Analysis of the current frame, runs on the task pool between tick and render */
+    audio::task_pool::task m_analysis;
+    float m_tick_seconds = 0.f;
+    static void analyze(void *data);
+
+    /* Last drawn frame, drawn again as it is while the output doesn't change */
+    gs_texrender_t *m_cache = nullptr;
+    bool m_cache_valid = false; /* Cleared by settings changes */
+    void draw_visualizer();
+
+    /* Adopts the pending settings, if any, on the video thread */
+    void apply_pending();
+    void apply(const config_values &values);
     std::map<uint16_t, std::string> m_source_names;
 
 public:
@@ -106,6 +168,9 @@ public:
 
     void clear_source_names() { m_source_names.clear(); }
     void add_source(uint16_t id, const char *name) { m_source_names[id] = name; }
+
+    /* Writes the current statistics into the read-only stats text property */
+    void write_stats();
 };
 
 /* Util for registering the source */
@@ -17,6 +17,7 @@
  *************************************************************************/
 
 #include "source/visualizer_source.hpp"
+#include "util/audio/task_pool.hpp"
 #include <obs-module.h>
 
 OBS_DECLARE_MODULE()
@@ -37,5 +38,5 @@ bool obs_module_load()
 
 void obs_module_unload()
 {
-    /* NO-OP */
+    audio::task_pool::instance().stop();
 }
@@ -0,0 +1,51 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#include "arena.hpp"
+#include <cstring>
+#include <util/bmem.h>
+
+namespace audio {
+
+arena::~arena()
+{
+    bfree(m_raw);
+}
+
+void arena::begin()
+{
+    m_used = 0;
+    m_committed = false;
+}
+
+void arena::commit()
+{
+    if (m_used > m_capacity) {
+        bfree(m_raw);
+        m_raw = static_cast<uint8_t *>(bmalloc(m_used + alignment - 1));
+        m_block = reinterpret_cast<uint8_t *>(align(reinterpret_cast<uintptr_t>(m_raw)));
+        m_capacity = m_used;
+    }
+
+    if (m_block)
+        memset(m_block, 0, m_used);
+    m_used = 0;
+    m_committed = true;
+}
+
+}
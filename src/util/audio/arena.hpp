@@ -0,0 +1,137 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace audio {
+
+/* Fixed size view into an arena, has the parts of the std::vector
+ * interface the dsp code uses, but can't grow */
+template<class T> class arena_array {
+    T *m_data = nullptr;
+    size_t m_size = 0;
+
+public:
+    arena_array() = default;
+    arena_array(T *data, size_t size) : m_data(data), m_size(size) {}
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    T *data() { return m_data; }
+    const T *data() const { return m_data; }
+
+    T &operator[](size_t i) { return m_data[i]; }
+    const T &operator[](size_t i) const { return m_data[i]; }
+
+    T *begin() { return m_data; }
+    T *end() { return m_data + m_size; }
+    const T *begin() const { return m_data; }
+    const T *end() const { return m_data + m_size; }
+};
+
+/* Fixed capacity fifo on top of an arena_array, pushing
+ * onto a full ring drops the oldest value */
+template<class T> class arena_ring {
+    arena_array<T> m_storage;
+    size_t m_start = 0, m_size = 0;
+
+public:
+    arena_ring() = default;
+    explicit arena_ring(arena_array<T> storage) : m_storage(storage) {}
+
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_storage.size(); }
+    bool empty() const { return m_size == 0; }
+    void clear() { m_start = m_size = 0; }
+
+    /* Oldest value is at index zero */
+    T &operator[](size_t i) { return m_storage[(m_start + i) % m_storage.size()]; }
+    const T &operator[](size_t i) const { return m_storage[(m_start + i) % m_storage.size()]; }
+
+    void push_back(const T &value)
+    {
+        if (m_storage.empty())
+            return;
+        if (m_size == m_storage.size())
+            pop_front(1);
+        m_storage[(m_start + m_size++) % m_storage.size()] = value;
+    }
+
+    void pop_front(size_t count)
+    {
+        if (count > m_size)
+            count = m_size;
+        if (count)
+            m_start = (m_start + count) % m_storage.size();
+        m_size -= count;
+    }
+};
+
+/* All dsp buffers of a visualizer in one block. Every array starts on its
+ * own cache line, which is also more than the alignment the simd kernels
+ * of fftw expect. Laid out in two passes over the same code, the first
+ * one only measures, the second one hands out the memory:
+ *
+ *     a.begin(); layout(a); a.commit(); layout(a);
+ *
+ * The block only ever grows, so structural changes that don't need more
+ * memory don't allocate */
+class arena {
+public:
+    static const size_t alignment = 64;
+
+private:
+    uint8_t *m_raw = nullptr;   /* As returned by bmalloc */
+    uint8_t *m_block = nullptr; /* m_raw aligned up */
+    size_t m_capacity = 0, m_used = 0;
+    bool m_committed = false;
+
+    static size_t align(size_t bytes) { return (bytes + alignment - 1) & ~(alignment - 1); }
+
+public:
+    arena() = default;
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+    ~arena();
+
+    /* Starts the measuring pass */
+    void begin();
+
+    /* Makes sure the block can hold everything that was measured, zeroes
+     * it and starts the pass that hands out memory */
+    void commit();
+
+    /* Null while measuring */
+    template<class T> T *alloc(size_t count)
+    {
+        uint8_t *ptr = m_committed ? m_block + m_used : nullptr;
+        m_used += align(count * sizeof(T));
+        return reinterpret_cast<T *>(ptr);
+    }
+
+    template<class T> arena_array<T> alloc_array(size_t count) { return arena_array<T>(alloc<T>(count), count); }
+
+    size_t capacity() const { return m_capacity; }
+    /* True during the second pass */
+    bool committed() const { return m_committed; }
+};
+
+}
@@ -0,0 +1,36 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "audio_source.hpp"
+#include "../../source/visualizer_source.hpp"
+#include "fifo.hpp"
+#include "obs_internal_source.hpp"
+
+namespace audio {
+
+audio_source *audio_source::create(source::config *cfg)
+{
+    if (cfg->audio_source_name.empty() || cfg->audio_source_name == std::string(defaults::audio_source))
+        return nullptr;
+    if (cfg->audio_source_name == std::string("mpd"))
+        return new fifo(cfg);
+    return new obs_internal_source(cfg);
+}
+
+}
@@ -35,6 +35,10 @@ public:
 
     virtual ~audio_source() {}
 
+    /* The source the settings ask for, nullptr if there's none. Kept
+     * apart from the visualizers, so headless builds can bring their own */
+    static audio_source *create(source::config *cfg);
+
     /* obs_source methods */
     virtual void update() = 0;
     virtual bool tick(float seconds) = 0;
@@ -19,8 +19,6 @@
 #include "audio_visualizer.hpp"
 #include "../../source/visualizer_source.hpp"
 #include "audio_source.hpp"
-#include "fifo.hpp"
-#include "obs_internal_source.hpp"
 
 namespace audio {
 
@@ -33,32 +31,48 @@ audio_visualizer::~audio_visualizer()
 {
     delete m_source;
     m_source = nullptr;
+    /* The buffer lives in the arena */
+    m_cfg->buffer = nullptr;
 }
 
-void audio_visualizer::update()
+void audio_visualizer::layout(arena &a)
 {
-    if (m_source)
+    m_cfg->buffer = a.alloc<pcm_stereo_sample>(m_cfg->sample_size);
+}
+
+void audio_visualizer::update(uint32_t dirty)
+{
+    if (m_source && (dirty & DIRTY_AUDIO))
         m_source->update();
     if (!m_source || m_cfg->audio_source_name != m_source_id) {
         m_source_id = m_cfg->audio_source_name;
         if (m_source)
             delete m_source;
-        if (m_cfg->audio_source_name.empty() || m_cfg->audio_source_name == std::string(defaults::audio_source)) {
-            m_source = nullptr;
-        } else if (m_cfg->audio_source_name == std::string("mpd")) {
-            m_source = new fifo(m_cfg);
-        } else {
-            m_source = new obs_internal_source(m_cfg);
-        }
+        m_source = audio_source::create(m_cfg);
+    }
+
+    /* The audio source might have changed the sample size */
+    if ((dirty & m_layout_deps) || m_layout_size != m_cfg->sample_size) {
+        m_arena.begin();
+        layout(m_arena);
+        m_arena.commit();
+        layout(m_arena);
+        m_layout_size = m_cfg->sample_size;
+        on_layout();
     }
 }
 
 void audio_visualizer::tick(float seconds)
 {
-    if (m_source)
+    PROFILE_SCOPE(m_cfg->profiler, stats::ST_AUDIO);
+    if (m_source) {
         m_data_read = m_source->tick(seconds);
-    else
+        m_cfg->health.ticks++;
+        if (!m_data_read)
+            m_cfg->health.underruns++;
+    } else {
         m_data_read = false;
+    }
 
 #ifdef LINUX
     if (m_cfg->auto_clear && !m_data_read) {
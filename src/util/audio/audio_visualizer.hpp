@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include "../util.hpp"
+#include "arena.hpp"
 #include <graphics/graphics.h>
 #include <string>
 
@@ -35,16 +37,36 @@ protected:
     std::string m_source_id = "none"; /* where to read audio from */
     bool m_data_read = false;         /* Audio source will return false if reading failed */
 
+    /* Holds the pcm buffer and the dsp state of subclasses */
+    arena m_arena;
+    uint32_t m_layout_size = 0;            /* Sample size of the current layout */
+    uint32_t m_layout_deps = DIRTY_AUDIO; /* Settings groups the layout depends on */
+
+    /* Places all buffers in the arena, called once to measure and once
+     * to assign, see arena. Overrides have to call the base first */
+    virtual void layout(arena &a);
+    /* Called after the arena was rebuilt, everything in it is zeroed */
+    virtual void on_layout() {}
+
 public:
     audio_visualizer(source::config *cfg);
     virtual ~audio_visualizer();
 
-    virtual void update();
+    /* dirty is a mask of dirty_flags, only what depends on those is rebuilt */
+    virtual void update(uint32_t dirty);
 
     /* Active is set to true, if the current tick is in sync with the
      * user configured fps */
     virtual void tick(float seconds);
 
+    /* Whether the drawn output differs from the last call, the source
+     * draws its cached frame otherwise */
+    virtual bool output_changed() { return true; }
+
+    /* Whether render() binds its own effect, otherwise it's
+     * called inside a pass of the solid effect */
+    virtual bool own_effect() const { return false; }
+
     virtual void render(gs_effect_t *effect) = 0;
 };
 }
@@ -0,0 +1,131 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "bar_export.hpp"
+#include "../util.hpp"
+#include <cerrno>
+#include <cstring>
+#include <util/platform.h>
+
+#if defined(LINUX) || defined(MACOS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace audio {
+
+#if defined(LINUX) || defined(MACOS)
+bool bar_export::open(const std::string &name, uint32_t capacity)
+{
+    close();
+    m_name = name;
+    /* shm_open wants exactly one leading slash */
+    std::string path = name.empty() || name[0] != '/' ? "/" + name : name;
+
+    m_size = sizeof(bar_export_header) + sizeof(float) * capacity * 2;
+    /* Never take over a segment that already exists, it belongs to another source or a crashed instance */
+    m_fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (m_fd < 0 && errno == EEXIST) {
+        warn("The shared memory segment %s already exists, the bars are not exported. Give every source its own "
+             "name or remove /dev/shm%s if it was left behind",
+             path.c_str(), path.c_str());
+        m_name.clear();
+        return false;
+    }
+    if (m_fd < 0 || ftruncate(m_fd, m_size) != 0) {
+        warn("Couldn't create the shared memory segment %s for the bar export", path.c_str());
+        close();
+        return false;
+    }
+
+    void *map = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        warn("Couldn't map the shared memory segment %s for the bar export", path.c_str());
+        close();
+        return false;
+    }
+
+    /* Readers only trust the segment once the magic is set */
+    m_header = static_cast<bar_export_header *>(map);
+    memset(map, 0, m_size);
+    m_header->version = BAR_EXPORT_VERSION;
+    m_header->capacity = capacity;
+    m_header->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = BAR_EXPORT_MAGIC;
+    info("Exporting bars to shared memory segment %s", path.c_str());
+    return true;
+}
+
+void bar_export::close()
+{
+    if (m_header) {
+        m_header->magic = 0;
+        munmap(m_header, m_size);
+        m_header = nullptr;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        std::string path = m_name.empty() || m_name[0] != '/' ? "/" + m_name : m_name;
+        shm_unlink(path.c_str());
+        m_fd = -1;
+    }
+    m_name.clear();
+}
+#else /* Stubs on Windows */
+bool bar_export::open(const std::string &, uint32_t)
+{
+    warn("The shared memory bar export is only available on Linux and macOS");
+    return false;
+}
+
+void bar_export::close() {}
+#endif
+
+void bar_export::publish(const double *left, const double *right, uint32_t bars, uint32_t max_height)
+{
+    if (!m_header)
+        return;
+
+    /* Seqlock writer, odd while writing. There is only ever one writer */
+    const uint32_t sequence = m_header->sequence.load(std::memory_order_relaxed);
+    m_header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    bars = UTIL_MIN(bars, m_header->capacity);
+    m_header->frame = m_frame++;
+    m_header->timestamp = os_gettime_ns();
+    m_header->channels = right ? 2 : 1;
+    m_header->bars = bars;
+    m_header->max_height = max_height;
+
+    float *out = reinterpret_cast<float *>(m_header + 1);
+    for (uint32_t i = 0; i < bars; i++)
+        out[i] = static_cast<float>(left[i]);
+    if (right) {
+        out += m_header->capacity;
+        for (uint32_t i = 0; i < bars; i++)
+            out[i] = static_cast<float>(right[i]);
+    }
+
+    m_header->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,82 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/* Only depends on the standard library, so external readers can include it */
+
+#define BAR_EXPORT_MAGIC 0x43455053 /* "SPEC" */
+#define BAR_EXPORT_VERSION 1
+
+/* Layout of the shared memory segment. One source writes, any number of
+ * processes map it read-only. A reader waits for an even sequence, reads what
+ * it needs in place and starts over if the sequence changed in the meantime */
+struct bar_export_header {
+    uint32_t magic;   /* Zeroed once the source stops exporting, reopen the segment then */
+    uint32_t version;
+    uint32_t capacity;              /* Bars per channel there is room for */
+    std::atomic<uint32_t> sequence; /* Odd while a frame is being written */
+    uint64_t frame;                 /* Number of the published frame */
+    uint64_t timestamp;             /* Nanoseconds, os_gettime_ns() of the writer */
+    uint32_t channels;              /* One or two */
+    uint32_t bars;                  /* Per channel */
+    uint32_t max_height;            /* Bar height in pixels, a bar of this height is full scale */
+    uint32_t reserved;
+    /* Followed by capacity floats per channel, left first */
+};
+
+static_assert(sizeof(bar_export_header) == 48, "The segment layout is shared with other processes");
+
+inline const float *bar_export_heights(const bar_export_header *header, uint32_t channel)
+{
+    return reinterpret_cast<const float *>(header + 1) + channel * header->capacity;
+}
+
+namespace audio {
+
+/* Publishes the bars of a spectrum visualizer into a POSIX shared memory segment.
+ * Publishing only writes to memory, it never blocks or waits on readers */
+class bar_export {
+    int m_fd = -1;
+    bar_export_header *m_header = nullptr;
+    size_t m_size = 0;
+    std::string m_name;
+    uint64_t m_frame = 0;
+
+public:
+    bar_export() = default;
+    bar_export(const bar_export &) = delete;
+    bar_export &operator=(const bar_export &) = delete;
+    ~bar_export() { close(); }
+
+    /* Creates the segment, sized for capacity bars per channel */
+    bool open(const std::string &name, uint32_t capacity);
+    void close();
+
+    bool is_open() const { return m_header != nullptr; }
+    const std::string &name() const { return m_name; }
+    uint32_t capacity() const { return m_header ? m_header->capacity : 0; }
+
+    void publish(const double *left, const double *right, uint32_t bars, uint32_t max_height);
+};
+
+}
@@ -0,0 +1,260 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "bar_stream.hpp"
+#include "../util.hpp"
+#include <random>
+#include <util/platform.h>
+
+#if defined(LINUX) || defined(MACOS)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace audio {
+
+/* Most bars per channel a key frame of two channels can carry */
+static uint32_t max_bars(bool wide)
+{
+    return static_cast<uint32_t>((constants::stream_max_datagram - sizeof(bar_stream_header)) / (wide ? 4 : 2));
+}
+
+#if defined(LINUX) || defined(MACOS)
+/* Fills in the sockaddr for a path or host:port */
+static bool parse_address(const std::string &address, std::vector<uint8_t> &out)
+{
+    if (!address.empty() && address[0] == '/') {
+        struct sockaddr_un un = {};
+        if (address.size() >= sizeof(un.sun_path))
+            return false;
+        un.sun_family = AF_UNIX;
+        memcpy(un.sun_path, address.c_str(), address.size() + 1);
+        out.assign(reinterpret_cast<uint8_t *>(&un), reinterpret_cast<uint8_t *>(&un) + sizeof(un));
+        return true;
+    }
+
+    auto colon = address.rfind(':');
+    if (colon == std::string::npos)
+        return false;
+    std::string host = address.substr(0, colon);
+    long port = strtol(address.c_str() + colon + 1, nullptr, 10);
+    if (host.empty() || host == "localhost")
+        host = "127.0.0.1";
+
+    struct sockaddr_in in = {};
+    in.sin_family = AF_INET;
+    in.sin_port = htons(static_cast<uint16_t>(port));
+    if (port <= 0 || port > UINT16_MAX || inet_pton(AF_INET, host.c_str(), &in.sin_addr) != 1)
+        return false;
+    out.assign(reinterpret_cast<uint8_t *>(&in), reinterpret_cast<uint8_t *>(&in) + sizeof(in));
+    return true;
+}
+
+bool bar_stream::open(const std::string &address, bool wide, uint32_t capacity)
+{
+    close();
+    if (!parse_address(address, m_address)) {
+        warn("'%s' is neither a socket path nor host:port, not streaming the bars", address.c_str());
+        return false;
+    }
+
+    auto family = reinterpret_cast<const sockaddr *>(m_address.data())->sa_family;
+    m_socket = socket(family, SOCK_DGRAM, 0);
+    /* A slow receiver drops frames instead of stalling the sender */
+    if (m_socket < 0 || fcntl(m_socket, F_SETFL, O_NONBLOCK) != 0) {
+        warn("Couldn't create a socket to stream the bars to %s", address.c_str());
+        close();
+        return false;
+    }
+
+    m_name = address;
+    m_wide = wide;
+    m_capacity = capacity;
+    for (frame *f : {&m_next, &m_current, &m_sent})
+        f->values.assign(capacity * 2, 0);
+    m_queue.resize(constants::stream_queue);
+    for (auto &f : m_queue)
+        f.values.assign(capacity * 2, 0);
+    /* Room for a delta frame that turns out larger than the key frame it's replaced by */
+    m_packet.resize(sizeof(bar_stream_header) + capacity * 2 * (wide ? 2 : 1) + 3);
+
+    m_head = m_queued = 0;
+    m_dropped = m_sequence = m_since_key = 0;
+    /* A new id for every open, so a receiver never applies deltas across a restart */
+    m_stream = std::random_device()();
+    m_need_key = true;
+    m_stop = false;
+    m_thread = std::thread(&bar_stream::run, this);
+    info("Streaming bars to %s", address.c_str());
+    return true;
+}
+
+void bar_stream::close()
+{
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_ready.notify_one();
+        m_thread.join();
+    }
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+    m_name.clear();
+}
+
+void bar_stream::run()
+{
+    for (;;) {
+        uint32_t dropped;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [this] { return m_stop || m_queued > 0; });
+            if (m_stop)
+                return;
+            /* Swapping keeps every buffer allocated, the slot gets the old one */
+            std::swap(m_current, m_queue[m_head]);
+            m_head = (m_head + 1) % m_queue.size();
+            m_queued--;
+            dropped = m_dropped;
+        }
+
+        size_t size = encode(dropped);
+        auto *to = reinterpret_cast<const sockaddr *>(m_address.data());
+        if (sendto(m_socket, m_packet.data(), size, 0, to, static_cast<socklen_t>(m_address.size())) < 0) {
+            /* Nobody listening or the receiver is behind, it can't apply the next delta */
+            m_need_key = true;
+        } else {
+            std::swap(m_sent, m_current);
+        }
+    }
+}
+#else /* Stubs on Windows */
+bool bar_stream::open(const std::string &, bool, uint32_t)
+{
+    warn("Streaming the bars is only available on Linux and macOS");
+    return false;
+}
+
+void bar_stream::close() {}
+
+void bar_stream::run() {}
+#endif
+
+size_t bar_stream::encode(uint32_t dropped)
+{
+    const frame &f = m_current;
+    const size_t count = static_cast<size_t>(f.bars) * (f.stereo ? 2 : 1);
+    const size_t key_size = count * (m_wide ? 2 : 1);
+    uint8_t *out = m_packet.data() + sizeof(bar_stream_header);
+    size_t size = 0;
+
+    bool delta = !m_need_key && m_since_key < constants::stream_key_interval && m_sent.bars == f.bars &&
+                 m_sent.stereo == f.stereo;
+    for (size_t i = 0; delta && i < count;) {
+        uint32_t token;
+        if (f.values[i] == m_sent.values[i]) {
+            size_t run = 1;
+            while (i + run < count && f.values[i + run] == m_sent.values[i + run])
+                run++;
+            token = static_cast<uint32_t>(run - 1) << 1 | 1;
+            i += run;
+        } else {
+            const int32_t d = static_cast<int32_t>(f.values[i]) - static_cast<int32_t>(m_sent.values[i]);
+            token = ((static_cast<uint32_t>(d) << 1) ^ static_cast<uint32_t>(d >> 31)) << 1;
+            i++;
+        }
+        while (token >= 0x80) {
+            out[size++] = static_cast<uint8_t>(token | 0x80);
+            token >>= 7;
+        }
+        out[size++] = static_cast<uint8_t>(token);
+        /* Sudden jumps everywhere, the values themselves are shorter */
+        if (size >= key_size)
+            delta = false;
+    }
+
+    if (!delta) {
+        if (m_wide)
+            memcpy(out, f.values.data(), key_size);
+        else
+            for (size_t i = 0; i < count; i++)
+                out[i] = static_cast<uint8_t>(f.values[i]);
+        size = key_size;
+        m_since_key = 0;
+        m_need_key = false;
+    } else {
+        m_since_key++;
+    }
+
+    bar_stream_header header;
+    header.magic = BAR_STREAM_MAGIC;
+    header.version = BAR_STREAM_VERSION;
+    header.flags = (m_wide ? BSF_WIDE : 0) | (delta ? BSF_DELTA : 0) | (f.stereo ? BSF_STEREO : 0);
+    header.bars = f.bars;
+    header.timestamp = f.timestamp;
+    header.sequence = m_sequence++;
+    header.dropped = dropped;
+    header.stream = m_stream;
+    header.reserved = 0;
+    memcpy(m_packet.data(), &header, sizeof(header));
+    return sizeof(header) + size;
+}
+
+void bar_stream::publish(const double *left, const double *right, uint32_t bars, uint32_t max_height)
+{
+    if (!is_open())
+        return;
+
+    /* Quantized outside of the lock, the sender only ever waits for a swap */
+    const double full = m_wide ? UINT16_MAX : UINT8_MAX;
+    const double scale = max_height ? full / max_height : 0.0;
+    bars = UTIL_MIN(bars, UTIL_MIN(m_capacity, max_bars(m_wide)));
+    m_next.bars = static_cast<uint16_t>(bars);
+    m_next.stereo = right != nullptr;
+    m_next.timestamp = os_gettime_ns();
+    for (int channel = 0; channel < (right ? 2 : 1); channel++) {
+        const double *in = channel ? right : left;
+        uint16_t *out = m_next.values.data() + channel * bars;
+        for (uint32_t i = 0; i < bars; i++)
+            out[i] = static_cast<uint16_t>(UTIL_CLAMP(0.0, round(in[i] * scale), full));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queued == m_queue.size()) {
+            /* The sender is behind, the newest frame matters more */
+            m_head = (m_head + 1) % m_queue.size();
+            m_queued--;
+            m_dropped++;
+        }
+        std::swap(m_next, m_queue[(m_head + m_queued) % m_queue.size()]);
+        m_queued++;
+    }
+    m_ready.notify_one();
+}
+
+}
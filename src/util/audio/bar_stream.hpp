@@ -0,0 +1,179 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* The format part only depends on the standard library, so receivers can include it */
+
+#define BAR_STREAM_MAGIC 0x53435053 /* "SPCS" */
+#define BAR_STREAM_VERSION 2
+
+/* Every datagram holds one frame, the header below followed by the bars of all
+ * channels, left first, in host byte order. The bars are quantized to 8 or 16 bit,
+ * the largest value is a bar of full height. Key frames hold the values as they
+ * are, delta frames the difference to the frame before as varints. A token with
+ * the lowest bit set skips (token >> 1) + 1 unchanged values, otherwise token >> 1
+ * is the zigzag encoded difference, so resting bars cost next to nothing. A
+ * receiver that missed a frame waits for the next key frame, one is sent at
+ * least every second or so. Several sources can send to the same address,
+ * receivers keep apart their frames by the stream id */
+enum bar_stream_flags {
+    BSF_WIDE = 1,   /* 16 bit values */
+    BSF_DELTA = 2,  /* Differences to the frame with the previous sequence number */
+    BSF_STEREO = 4, /* Two channels */
+};
+
+struct bar_stream_header {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint16_t bars;      /* Per channel */
+    uint64_t timestamp; /* Nanoseconds, os_gettime_ns() of the sender */
+    uint32_t sequence;  /* Counts every frame the sender tried to send */
+    uint32_t dropped;   /* Frames the sender skipped because its queue was full */
+    uint32_t stream;    /* Random, picked every time the sender opens the stream */
+    uint32_t reserved;
+};
+
+static_assert(sizeof(bar_stream_header) == 32, "The header is part of the wire format");
+
+/* Decodes one datagram into values. A delta frame is applied to values, which has
+ * to hold the frame of the same stream with the previous sequence number. Returns false
+ * if the datagram is broken or doesn't fit, values can't be used for deltas until the
+ * next key frame */
+inline bool bar_stream_decode(const uint8_t *data, size_t size, uint32_t stream, uint32_t last_sequence,
+                              bar_stream_header &header, std::vector<uint16_t> &values)
+{
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != BAR_STREAM_MAGIC || header.version != BAR_STREAM_VERSION)
+        return false;
+
+    const size_t count = static_cast<size_t>(header.bars) * (header.flags & BSF_STEREO ? 2 : 1);
+    const uint8_t *in = data + sizeof(header), *end = data + size;
+
+    if (!(header.flags & BSF_DELTA)) {
+        const size_t width = header.flags & BSF_WIDE ? 2 : 1;
+        if (static_cast<size_t>(end - in) < count * width)
+            return false;
+        values.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            if (width == 2)
+                memcpy(&values[i], in + i * 2, 2);
+            else
+                values[i] = in[i];
+        }
+        return true;
+    }
+
+    if (values.size() != count || header.stream != stream || header.sequence != last_sequence + 1)
+        return false;
+    size_t i = 0;
+    while (i < count) {
+        uint32_t token = 0;
+        for (int shift = 0;; shift += 7) {
+            if (in == end || shift > 14)
+                return false;
+            token |= static_cast<uint32_t>(*in & 0x7f) << shift;
+            if (!(*in++ & 0x80))
+                break;
+        }
+        if (token & 1) {
+            i += (token >> 1) + 1;
+        } else {
+            const uint32_t zigzag = token >> 1;
+            const int32_t delta = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+            values[i] = static_cast<uint16_t>(values[i] + delta);
+            i++;
+        }
+    }
+    return in == end && i == count;
+}
+
+namespace audio {
+
+/* Streams the bars of a spectrum visualizer as datagrams to a unix domain socket
+ * (an address starting with a slash) or a udp port (host:port). The visualizer only
+ * quantizes the bars into a bounded queue, a background thread encodes and sends
+ * them. If the queue is full the oldest frame is dropped, the caller never waits */
+class bar_stream {
+    struct frame {
+        std::vector<uint16_t> values; /* Sized for two channels at full capacity */
+        uint16_t bars = 0;
+        bool stereo = false;
+        uint64_t timestamp = 0;
+    };
+
+    int m_socket = -1;
+    std::vector<uint8_t> m_address; /* sockaddr for sendto() */
+    std::string m_name;
+    bool m_wide = false;
+    uint32_t m_capacity = 0;
+
+    /* Ring of queued frames, shared with the sender thread */
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::vector<frame> m_queue;
+    size_t m_head = 0, m_queued = 0;
+    uint32_t m_dropped = 0;
+    bool m_stop = false;
+
+    /* Only used by the caller of publish() */
+    frame m_next;
+
+    /* Only used by the sender thread */
+    frame m_current, m_sent;
+    std::vector<uint8_t> m_packet;
+    uint32_t m_sequence = 0;
+    uint32_t m_stream = 0;
+    uint32_t m_since_key = 0;
+    bool m_need_key = true;
+
+    void run();
+    /* Encodes m_current into m_packet, returns the datagram size */
+    size_t encode(uint32_t dropped);
+
+public:
+    bar_stream() = default;
+    bar_stream(const bar_stream &) = delete;
+    bar_stream &operator=(const bar_stream &) = delete;
+    ~bar_stream() { close(); }
+
+    /* Creates the socket and starts the sender, 16 bit values if wide is set */
+    bool open(const std::string &address, bool wide, uint32_t capacity);
+    void close();
+
+    bool is_open() const { return m_socket >= 0; }
+    const std::string &address() const { return m_name; }
+    bool wide() const { return m_wide; }
+    uint32_t capacity() const { return m_capacity; }
+
+    void publish(const double *left, const double *right, uint32_t bars, uint32_t max_height);
+};
+
+}
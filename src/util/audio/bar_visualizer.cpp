@@ -19,55 +19,79 @@
 #include "bar_visualizer.hpp"
 #include "../../source/visualizer_source.hpp"
 #include "../../util/util.hpp"
+#include <algorithm>
 
 namespace audio {
 
-void bar_visualizer::draw_rectangle_bars()
+/* Same clamping for all paths, so they draw the same heights */
+static uint32_t clamp_height(double val, uint32_t min_height, uint32_t max_height)
 {
-    size_t i = 0, pos_x = 0;
-    uint32_t height;
-    for (; i < m_bars_left.size() - DEAD_BAR_OFFSET; i++) { /* Leave the four dead bars the end */
-        auto val = m_bars_left[i] > 1.0 ? m_bars_left[i] : 1.0;
-        height = UTIL_MAX(static_cast<uint32_t>(round(val)), 1);
-        height = UTIL_MIN(height, m_cfg->bar_height);
+    uint32_t height = UTIL_MAX(static_cast<uint32_t>(round(val > 1.0 ? val : 1.0)), min_height);
+    return UTIL_MIN(height, max_height);
+}
 
-        pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-        gs_matrix_push();
-        gs_matrix_translate3f(pos_x, (m_cfg->bar_height - height), 0);
-        gs_draw_sprite(nullptr, 0, m_cfg->bar_width, height);
-        gs_matrix_pop();
+gs_vertbuffer_t *bar_visualizer::fill_chunk(vertex_buffer &vb, size_t first, size_t last)
+{
+    const int32_t *heights = m_next_heights.data();
+    const float width = m_cfg->bar_width;
+    /* Signed, the space between the channels can be negative */
+    const int32_t offset = m_cfg->stereo_space / 2;
+    const float baseline = m_cfg->stereo ? m_cfg->bar_height / 2 : m_cfg->bar_height;
+
+    auto rectangle = [&](float x, float y, float h) {
+        vb.vertex2f(x, y);
+        vb.vertex2f(x + width, y);
+        vb.vertex2f(x, y + h);
+        vb.vertex2f(x + width, y);
+        vb.vertex2f(x + width, y + h);
+        vb.vertex2f(x, y + h);
+    };
+
+    vb.begin();
+    for (size_t i = first; i < last; i++) {
+        float x = i * (m_cfg->bar_width + m_cfg->bar_space);
+        rectangle(x, baseline - heights[i * 2], heights[i * 2]);
+        if (m_cfg->stereo)
+            rectangle(x, baseline + offset * 2, heights[i * 2 + 1]);
     }
+
+    std::copy(heights + first * 2, heights + last * 2, m_chunk_heights.data() + first * 2);
+    return vb.end();
 }
 
-void bar_visualizer::draw_stereo_rectangle_bars()
+void bar_visualizer::draw_rectangle_bars()
 {
-    size_t i = 0, pos_x = 0;
-    uint32_t height_l, height_r;
-    uint32_t offset = m_cfg->stereo_space / 2;
-    uint32_t center = m_cfg->bar_height / 2 + offset;
+    const size_t bars = m_bars_left.size() - DEAD_BAR_OFFSET; /* Leave the dead bars at the end */
+    const uint32_t max_height = m_cfg->stereo ? m_cfg->bar_height / 2 : m_cfg->bar_height;
+    int32_t *next = m_next_heights.data();
+    const int32_t *drawn = m_chunk_heights.data();
 
-    for (; i < m_bars_left.size() - DEAD_BAR_OFFSET; i++) { /* Leave the four dead bars the end */
-        double bar_left = (m_bars_left[i] > 1.0 ? m_bars_left[i] : 1.0);
-        double bar_right = (m_bars_right[i] > 1.0 ? m_bars_right[i] : 1.0);
+    for (size_t i = 0; i < bars; i++) {
+        next[i * 2] = clamp_height(m_bars_left[i], 1, max_height);
+        next[i * 2 + 1] = m_cfg->stereo ? clamp_height(m_bars_right[i], 1, max_height) : 0;
+    }
 
-        height_l = UTIL_MAX(static_cast<uint32_t>(round(bar_left)), 1);
-        height_l = UTIL_MIN(height_l, (m_cfg->bar_height / 2));
-        height_r = UTIL_MAX(static_cast<uint32_t>(round(bar_right)), 1);
-        height_r = UTIL_MIN(height_r, (m_cfg->bar_height / 2));
+    const size_t chunk_bars = constants::bar_chunk;
+    const size_t chunks = (bars + chunk_bars - 1) / chunk_bars;
+    if (chunks > m_chunk_count) {
+        delete[] m_chunks;
+        m_chunk_count = chunks;
+        m_chunks = new vertex_buffer[chunks];
+        std::fill(m_chunk_heights.begin(), m_chunk_heights.end(), 0);
+    }
 
-        pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
+    for (size_t c = 0; c < chunks; c++) {
+        const size_t first = c * chunk_bars, last = UTIL_MIN(first + chunk_bars, bars);
 
-        /* Top */
-        gs_matrix_push();
-        gs_matrix_translate3f(pos_x, (center - height_l) - offset, 0);
-        gs_draw_sprite(nullptr, 0, m_cfg->bar_width, height_l);
-        gs_matrix_pop();
+        /* Branchless so it's vectorized, most chunks don't change between frames */
+        int32_t changed = 0;
+        for (size_t i = first * 2; i < last * 2; i++)
+            changed |= next[i] ^ drawn[i];
 
-        /* Bottom */
-        gs_matrix_push();
-        gs_matrix_translate3f(pos_x, center + offset, 0);
-        gs_draw_sprite(nullptr, 0, m_cfg->bar_width, height_r);
-        gs_matrix_pop();
+        vertex_buffer &vb = m_chunks[c];
+        gs_vertbuffer_t *buffer = changed ? fill_chunk(vb, first, last) : vb.buffer();
+        gs_load_vertexbuffer(buffer);
+        gs_draw(GS_TRIS, 0, vb.size());
     }
 }
 
@@ -85,13 +109,12 @@ void bar_visualizer::draw_rounded_bars()
         height = UTIL_MIN(height, m_cfg->bar_height);
 
         pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-        auto verts = make_rounded_rectangle(height);
+        auto verts = make_rounded_rectangle(i, height);
         gs_matrix_push();
         gs_load_vertexbuffer(verts);
         gs_matrix_translate3f(pos_x, (m_cfg->bar_height - height), 0);
         gs_draw(GS_TRISTRIP, 0, (m_cfg->corner_points + 1) * 8 + 20);
         gs_matrix_pop();
-        gs_vertexbuffer_destroy(verts);
     }
 }
 
@@ -114,8 +137,8 @@ void bar_visualizer::draw_stereo_rounded_bars()
         height_r = UTIL_MIN(height_r, (m_cfg->bar_height / 2));
 
         pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-        auto verts_left = make_rounded_rectangle(height_l);
-        auto verts_right = make_rounded_rectangle(height_r);
+        auto verts_left = make_rounded_rectangle(i * 2, height_l);
+        auto verts_right = make_rounded_rectangle(i * 2 + 1, height_r);
 
         /* Top */
         gs_matrix_push();
@@ -130,34 +153,124 @@ void bar_visualizer::draw_stereo_rounded_bars()
         gs_matrix_translate3f(pos_x, center + offset, 0);
         gs_draw(GS_TRISTRIP, 0, (m_cfg->corner_points + 1) * 8 + 20);
         gs_matrix_pop();
+    }
+}
 
-        gs_vertexbuffer_destroy(verts_left);
-        gs_vertexbuffer_destroy(verts_right);
+bool bar_visualizer::load_effect()
+{
+    if (m_bar_effect || m_effect_failed)
+        return m_bar_effect;
+
+    char *file = obs_module_file("bars.effect");
+    char *errors = nullptr;
+    if (file)
+        m_bar_effect = gs_effect_create_from_file(file, &errors);
+
+    if (!m_bar_effect) {
+        warn("Couldn't load bars.effect, drawing the bars as geometry instead: %s",
+             errors ? errors : "file not found");
+        m_effect_failed = true;
     }
+    bfree(errors);
+    bfree(file);
+    return m_bar_effect;
+}
+
+void bar_visualizer::draw_shader_bars()
+{
+    if (!load_effect())
+        return;
+
+    const uint32_t bars = m_bars_left.size() - DEAD_BAR_OFFSET;
+    const uint32_t max_height = m_cfg->stereo ? m_cfg->bar_height / 2 : m_cfg->bar_height;
+    const uint32_t min_height = m_cfg->rounded_corners ? m_cfg->bar_width : 1;
+    float *top = m_texels.data(), *bottom = top + bars;
+
+    for (uint32_t i = 0; i < bars; i++) {
+        top[i] = clamp_height(m_bars_left[i], min_height, max_height);
+        bottom[i] = m_cfg->stereo ? clamp_height(m_bars_right[i], min_height, max_height) : 0.f;
+    }
+
+    /* Only recreated if the bar count changed, otherwise the heights are just uploaded */
+    if (m_heights && gs_texture_get_width(m_heights) != bars) {
+        gs_texture_destroy(m_heights);
+        m_heights = nullptr;
+    }
+    if (!m_heights)
+        m_heights = gs_texture_create(bars, 2, GS_R32F, 1, nullptr, GS_DYNAMIC);
+    gs_texture_set_image(m_heights, reinterpret_cast<const uint8_t *>(top), bars * sizeof(float), false);
+
+    /* Signed, the space between the channels can be negative */
+    const int32_t offset = m_cfg->stereo_space / 2;
+    struct vec4 color;
+    struct vec2 size;
+    vec4_from_rgba(&color, m_cfg->color);
+    vec2_set(&size, m_cfg->cx, m_cfg->cy);
+
+    auto param = [this](const char *name) { return gs_effect_get_param_by_name(m_bar_effect, name); };
+    gs_effect_set_texture(param("heights"), m_heights);
+    gs_effect_set_vec4(param("color"), &color);
+    gs_effect_set_vec2(param("size"), &size);
+    gs_effect_set_float(param("bar_width"), m_cfg->bar_width);
+    gs_effect_set_float(param("bar_pitch"), m_cfg->bar_width + m_cfg->bar_space);
+    gs_effect_set_float(param("bar_count"), bars);
+    gs_effect_set_float(param("baseline"), max_height);
+    gs_effect_set_float(param("gap"), m_cfg->stereo ? offset * 2 : 0);
+    gs_effect_set_float(param("radius"), m_cfg->rounded_corners ? m_corner_radius : 0.f);
+    gs_effect_set_float(param("stereo"), m_cfg->stereo ? 1.f : 0.f);
+
+    while (gs_effect_loop(m_bar_effect, "Draw"))
+        gs_draw_sprite(nullptr, 0, m_cfg->cx, m_cfg->cy);
 }
 
 bar_visualizer::bar_visualizer(source::config *cfg) : spectrum_visualizer(cfg) {}
 
+bar_visualizer::~bar_visualizer()
+{
+    delete[] m_chunks;
+    if (m_bar_effect || m_heights) {
+        obs_enter_graphics();
+        gs_effect_destroy(m_bar_effect);
+        if (m_heights)
+            gs_texture_destroy(m_heights);
+        obs_leave_graphics();
+    }
+}
+
+void bar_visualizer::layout(arena &a)
+{
+    spectrum_visualizer::layout(a);
+    m_texels = a.alloc_array<float>(m_cfg->detail * 2);
+    m_next_heights = a.alloc_array<int32_t>(m_cfg->detail * 2);
+    m_chunk_heights = a.alloc_array<int32_t>(m_cfg->detail * 2);
+}
+
+void bar_visualizer::update(uint32_t dirty)
+{
+    spectrum_visualizer::update(dirty);
+    /* Heights of zero are never drawn, so every chunk is rewritten */
+    if (dirty & DIRTY_GEOMETRY)
+        std::fill(m_chunk_heights.begin(), m_chunk_heights.end(), 0);
+}
+
+bool bar_visualizer::own_effect() const
+{
+    return m_cfg->gpu_bars && !m_effect_failed;
+}
+
 void bar_visualizer::render(gs_effect_t *effect)
 {
-    /* Just in case */
-    if (m_bars_left.size() != m_cfg->detail + DEAD_BAR_OFFSET)
-        m_bars_left.resize(m_cfg->detail + DEAD_BAR_OFFSET, 0.0);
-    if (m_bars_right.size() != m_cfg->detail + DEAD_BAR_OFFSET)
-        m_bars_right.resize(m_cfg->detail + DEAD_BAR_OFFSET, 0.0);
-
-    if (m_cfg->stereo) {
-        if (m_cfg->rounded_corners) {
-            draw_stereo_rounded_bars();
-        } else {
-            draw_stereo_rectangle_bars();
-        }
+    if (own_effect()) {
+        draw_shader_bars();
+        return;
+    }
+
+    if (!m_cfg->rounded_corners) {
+        draw_rectangle_bars();
+    } else if (m_cfg->stereo) {
+        draw_stereo_rounded_bars();
     } else {
-        if (m_cfg->rounded_corners) {
-            draw_rounded_bars();
-        } else {
-            draw_rectangle_bars();
-        }
+        draw_rounded_bars();
     }
     UNUSED_PARAMETER(effect);
 }
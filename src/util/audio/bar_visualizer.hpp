@@ -21,13 +21,37 @@
 
 namespace audio {
 class bar_visualizer : public spectrum_visualizer {
+    /* Rectangle bars are drawn from persistent buffers of constants::bar_chunk bars,
+     * only chunks where a bar moved by a pixel are rewritten and uploaded */
+    vertex_buffer *m_chunks = nullptr;
+    size_t m_chunk_count = 0;
+    arena_array<int32_t> m_next_heights;  /* Clamped heights of this frame, left and right interleaved */
+    arena_array<int32_t> m_chunk_heights; /* Heights the chunk buffers were last filled with */
+
+    gs_vertbuffer_t *fill_chunk(vertex_buffer &vb, size_t first, size_t last);
     void draw_rectangle_bars();
-    void draw_stereo_rectangle_bars();
     void draw_rounded_bars();
     void draw_stereo_rounded_bars();
 
+    /* Shader path, draws all bars with one quad, see data/bars.effect */
+    gs_effect_t *m_bar_effect = nullptr;
+    gs_texture_t *m_heights = nullptr; /* One texel per bar, the second row is the right channel */
+    arena_array<float> m_texels;      /* Staging copy of the clamped heights */
+    bool m_effect_failed = false;     /* Falls back to geometry if the effect doesn't compile */
+
+    bool load_effect();
+    void draw_shader_bars();
+
+protected:
+    void layout(arena &a) override;
+
 public:
     explicit bar_visualizer(source::config *cfg);
+    ~bar_visualizer() override;
+
+    void update(uint32_t dirty) override;
+
+    bool own_effect() const override;
     void render(gs_effect_t *effect) override;
 };
 }
@@ -48,7 +48,7 @@ void circle_bar_visualizer::draw_rounded_bar_circle()
     for (size_t i = 0; i < count; i++) { /* Leave the four dead bars the end */
         float pos = float(i) / (count);
         auto w = UTIL_MAX(m_bars_left[i], m_cfg->bar_width);
-        auto verts = make_rounded_rectangle(w);
+        auto verts = make_rounded_rectangle(i, w);
         gs_matrix_push();
         {
             gs_load_vertexbuffer(verts);
@@ -59,14 +59,10 @@ void circle_bar_visualizer::draw_rounded_bar_circle()
             gs_draw(GS_TRISTRIP, 0, (m_cfg->corner_points + 1) * 8 + 20);
         }
         gs_matrix_pop();
-        gs_vertexbuffer_destroy(verts);
     }
 }
 
-circle_bar_visualizer::circle_bar_visualizer(source::config *cfg) : spectrum_visualizer(cfg)
-{
-    update();
-}
+circle_bar_visualizer::circle_bar_visualizer(source::config *cfg) : spectrum_visualizer(cfg) {}
 
 void circle_bar_visualizer::render(gs_effect_t *)
 {
@@ -77,9 +73,10 @@ void circle_bar_visualizer::render(gs_effect_t *)
     }
 }
 
-void circle_bar_visualizer::update()
+void circle_bar_visualizer::update(uint32_t dirty)
 {
-    spectrum_visualizer::update();
+    spectrum_visualizer::update(dirty);
+    /* Cheap enough to always redo, the source resets cx & cy on every update */
     auto count = m_bars_left.empty() ? m_cfg->detail : m_bars_left.size();
     float spectrum_width = ((m_cfg->bar_width + m_cfg->bar_space) * count);
     m_radius = (spectrum_width * (1 + m_cfg->padding)) / (2 * M_PI);
@@ -30,6 +30,6 @@ class circle_bar_visualizer : public spectrum_visualizer {
 public:
     explicit circle_bar_visualizer(source::config *cfg);
     void render(gs_effect_t *effect) override;
-    void update() override;
+    void update(uint32_t dirty) override;
 };
 }
@@ -0,0 +1,177 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#include "constant_q.hpp"
+#include "../../source/visualizer_source.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace audio {
+
+void constant_q::build_kernel(const source::config *cfg)
+{
+    const double fs = cfg->sample_rate;
+    const double f_min = cfg->log_freq_start;
+    const double f_max = UTIL_MIN(cfg->high_cutoff_freq, fs / 2);
+    /* Neighbouring bars are this far apart, Q follows from that */
+    const double ratio = m_bars > 1 ? std::pow(f_max / f_min, 1.0 / (m_bars - 1)) : 2.0;
+    const double q = 1.0 / (ratio - 1.0);
+
+    /* The longest window belongs to the lowest bar */
+    const size_t longest = static_cast<size_t>(std::ceil(q * fs / f_min));
+    m_window = 1;
+    while (m_window < UTIL_MIN(longest, constants::cqt_max_window) || m_window < cfg->sample_size)
+        m_window <<= 1;
+
+    m_build.clear();
+    m_build_start.clear();
+
+    /* The temporal kernel of each bar is transformed to get its spectral kernel */
+    fftw_complex *t = fftw_alloc_complex(m_window);
+    fftw_plan p;
+    {
+        std::lock_guard<std::mutex> lock(fftw_planner_mutex());
+        p = fftw_plan_dft_1d(static_cast<int>(m_window), t, t, FFTW_FORWARD, FFTW_ESTIMATE);
+    }
+    const size_t bins = m_window / 2 + 1;
+
+    for (uint32_t k = 0; k < m_bars; k++) {
+        const double f = f_min * std::pow(ratio, k);
+        /* Windows that would be longer than the history are cut short, which
+         * widens the band of the lowest bars a bit */
+        const size_t n_k = UTIL_MAX(UTIL_MIN(static_cast<size_t>(std::ceil(q * fs / f)), m_window), size_t(2));
+        /* Aligned with the newest audio, which is at the end of the history */
+        const size_t start = m_window - n_k;
+
+        memset(t, 0, sizeof(fftw_complex) * m_window);
+        for (size_t n = 0; n < n_k; n++) {
+            const double w = (0.54 - 0.46 * std::cos(2 * M_PI * n / (n_k - 1))) / n_k; /* Hamming */
+            const double phase = 2 * M_PI * f * n / fs;
+            t[start + n][0] = w * std::cos(phase);
+            t[start + n][1] = w * std::sin(phase);
+        }
+        fftw_execute(p);
+
+        double peak = 0;
+        for (size_t j = 0; j < bins; j++)
+            peak = UTIL_MAX(peak, std::hypot(t[j][0], t[j][1]));
+
+        /* Only the few bins around the center frequency matter, the rest is dropped */
+        m_build_start.push_back(static_cast<uint32_t>(m_build.size()));
+        for (size_t j = 0; j < bins; j++) {
+            if (std::hypot(t[j][0], t[j][1]) < peak * constants::cqt_kernel_threshold)
+                continue;
+            kernel_entry e;
+            e.bin = static_cast<uint32_t>(j);
+            e.re = t[j][0] / m_window;
+            e.im = -t[j][1] / m_window;
+            m_build.push_back(e);
+        }
+    }
+    m_build_start.push_back(static_cast<uint32_t>(m_build.size()));
+
+    {
+        std::lock_guard<std::mutex> lock(fftw_planner_mutex());
+        fftw_destroy_plan(p);
+    }
+    fftw_free(t);
+}
+
+void constant_q::layout(arena &a, const source::config *cfg, uint32_t bars, size_t channels)
+{
+    if (!a.committed()) {
+        release();
+        m_bars = bars;
+        m_channels = channels;
+        build_kernel(cfg);
+    }
+
+    m_history = a.alloc<double>(m_window * m_channels);
+    m_spectrum = a.alloc<fftw_complex>((m_window / 2 + 1) * m_channels);
+    m_kernel = a.alloc_array<kernel_entry>(m_build.size());
+    m_kernel_start = a.alloc_array<uint32_t>(m_build_start.size());
+
+    if (a.committed()) {
+        std::copy(m_build.begin(), m_build.end(), m_kernel.begin());
+        std::copy(m_build_start.begin(), m_build_start.end(), m_kernel_start.begin());
+        std::vector<kernel_entry>().swap(m_build);
+        std::vector<uint32_t>().swap(m_build_start);
+    }
+}
+
+void constant_q::plan()
+{
+    std::lock_guard<std::mutex> lock(fftw_planner_mutex());
+    if (m_plan)
+        fftw_destroy_plan(m_plan);
+    int size = static_cast<int>(m_window);
+    m_plan = fftw_plan_many_dft_r2c(1, &size, static_cast<int>(m_channels), m_history, nullptr, 1, size, m_spectrum,
+                                    nullptr, 1, size / 2 + 1, FFTW_ESTIMATE);
+}
+
+void constant_q::release()
+{
+    std::lock_guard<std::mutex> lock(fftw_planner_mutex());
+    if (m_plan)
+        fftw_destroy_plan(m_plan);
+    m_plan = nullptr;
+}
+
+void constant_q::execute(const pcm_stereo_sample *buffer, size_t samples, bool mid_side)
+{
+    if (!m_plan)
+        return;
+
+    samples = UTIL_MIN(samples, m_window);
+    const size_t keep = m_window - samples;
+
+    for (size_t c = 0; c < m_channels; c++) {
+        double *history = m_history + c * m_window;
+        memmove(history, history + samples, keep * sizeof(double));
+
+        double *in = history + keep;
+        for (size_t i = 0; i < samples; i++) {
+            const double l = buffer[i].l, r = buffer[i].r;
+            if (mid_side)
+                in[i] = c == 0 ? (l + r) * .5 : (l - r) * .5;
+            else
+                in[i] = c == 0 ? l : r;
+        }
+    }
+
+    fftw_execute(m_plan);
+}
+
+void constant_q::magnitudes(size_t channel, arena_array<double> &out) const
+{
+    const fftw_complex *x = m_spectrum + channel * (m_window / 2 + 1);
+    const size_t count = UTIL_MIN(out.size(), static_cast<size_t>(m_bars));
+
+    for (size_t k = 0; k < count; k++) {
+        double re = 0, im = 0;
+        for (uint32_t i = m_kernel_start[k]; i < m_kernel_start[k + 1]; i++) {
+            const kernel_entry &e = m_kernel[i];
+            re += x[e.bin][0] * e.re - x[e.bin][1] * e.im;
+            im += x[e.bin][0] * e.im + x[e.bin][1] * e.re;
+        }
+        out[k] = std::sqrt(re * re + im * im);
+    }
+}
+
+}
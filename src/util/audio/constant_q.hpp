@@ -0,0 +1,77 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#pragma once
+#include "../util.hpp"
+#include "arena.hpp"
+#include <fftw3.h>
+#include <vector>
+
+namespace source {
+struct config;
+}
+
+namespace audio {
+
+/* Constant-Q transform after Brown & Puckette, "An efficient algorithm for
+ * the calculation of a constant Q transform". The bars are spaced
+ * logarithmically and every one of them gets a window whose length matches
+ * its bandwidth, so low bars get long windows and high bars short ones.
+ * The windows are precomputed as sparse kernels in the frequency domain,
+ * which makes every tick one fft over the recent audio plus a sparse
+ * multiply. The history spans several ticks, which is where the resolution
+ * for the bass comes from */
+class constant_q {
+    struct kernel_entry {
+        uint32_t bin;
+        double re, im; /* Conjugated and normalized kernel value */
+    };
+
+    size_t m_window = 0; /* Length of the history & fft, power of two */
+    size_t m_channels = 0;
+    uint32_t m_bars = 0;
+
+    double *m_history = nullptr;        /* m_window samples per channel, oldest first */
+    fftw_complex *m_spectrum = nullptr; /* m_window / 2 + 1 bins per channel */
+    arena_array<kernel_entry> m_kernel;
+    arena_array<uint32_t> m_kernel_start; /* Where the entries of each bar start, plus the end */
+    fftw_plan m_plan = nullptr;
+
+    /* Kernel computed during the measuring pass, until it can be moved into the arena */
+    std::vector<kernel_entry> m_build;
+    std::vector<uint32_t> m_build_start;
+
+    void build_kernel(const source::config *cfg);
+
+public:
+    ~constant_q() { release(); }
+
+    /* Computes the kernels while the arena is measured and moves them into it afterwards */
+    void layout(arena &a, const source::config *cfg, uint32_t bars, size_t channels);
+    /* Has to be called once the arena is committed */
+    void plan();
+    void release();
+
+    /* Appends the new samples to the history and transforms it */
+    void execute(const pcm_stereo_sample *buffer, size_t samples, bool mid_side);
+
+    /* Magnitude of every bar of one channel */
+    void magnitudes(size_t channel, arena_array<double> &out) const;
+};
+
+}
@@ -0,0 +1,123 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "decimator.hpp"
+#include "../../source/visualizer_source.hpp"
+#include <cmath>
+#include <cstring>
+
+namespace audio {
+
+size_t decimator::pick_factor(const source::config *cfg)
+{
+    /* The constant-Q kernels are built for the full rate */
+    if (!cfg->decimate || cfg->freq_scale == FS_CQT || cfg->high_cutoff_freq <= 0)
+        return 1;
+
+    const double max = cfg->sample_rate / (2.0 * cfg->high_cutoff_freq * constants::decimation_margin);
+    const size_t limit = UTIL_MIN(static_cast<size_t>(max), constants::decimation_max);
+
+    /* Only factors that divide the window, so every tick yields the same amount of samples */
+    for (size_t factor = limit; factor > 1; factor--) {
+        if (cfg->sample_size % factor == 0)
+            return factor;
+    }
+    return 1;
+}
+
+void decimator::layout(arena &a, size_t factor, size_t samples, size_t channels)
+{
+    m_factor = factor;
+    m_samples = samples;
+    m_channels = channels;
+
+    if (factor < 2) {
+        m_taps = arena_array<double>();
+        m_work = arena_array<double>();
+        return;
+    }
+
+    const size_t taps = constants::decimation_taps * factor;
+    m_taps = a.alloc_array<double>(taps);
+    m_work = a.alloc_array<double>((taps - 1 + samples) * channels);
+}
+
+void decimator::prepare()
+{
+    if (m_factor < 2 || m_taps.empty())
+        return;
+
+    /* Windowed sinc with its cutoff at the new nyquist frequency. With the
+     * margin in pick_factor() the transition band of the blackman window
+     * stays above high_cutoff_freq */
+    const size_t taps = m_taps.size();
+    const double cutoff = 0.5 / m_factor; /* In cycles per input sample */
+    const double center = (taps - 1) / 2.0;
+    double sum = 0.0;
+
+    for (size_t n = 0; n < taps; n++) {
+        const double x = 2.0 * cutoff * (n - center);
+        const double sinc = x == 0.0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+        const double p = 2.0 * M_PI * n / (taps - 1);
+        const double window = 0.42 - 0.5 * std::cos(p) + 0.08 * std::cos(2.0 * p);
+        m_taps[taps - 1 - n] = sinc * window;
+        sum += sinc * window;
+    }
+
+    /* A gain of factor keeps the fft magnitudes, and with them the bar
+     * heights, where they were with the full window */
+    for (double &tap : m_taps)
+        tap *= m_factor / sum;
+}
+
+void decimator::process(double *io, size_t stride, size_t channel)
+{
+    if (m_factor < 2 || channel >= m_channels)
+        return;
+
+    const size_t taps = m_taps.size(), history = taps - 1;
+    double *work = m_work.data() + channel * (history + m_samples);
+    const double *h = m_taps.data();
+
+    for (size_t i = 0; i < m_samples; i++)
+        work[history + i] = io[i * stride];
+
+    /* Four partial sums, since the compiler can't reorder a floating point
+     * sum on its own, this is what allows it to vectorize the loop */
+    const size_t outputs = m_samples / m_factor;
+    for (size_t m = 0; m < outputs; m++) {
+        const double *x = work + (m + 1) * m_factor - 1;
+        double a0 = 0.0, a1 = 0.0, a2 = 0.0, a3 = 0.0;
+        size_t k = 0;
+        for (; k + 4 <= taps; k += 4) {
+            a0 += h[k] * x[k];
+            a1 += h[k + 1] * x[k + 1];
+            a2 += h[k + 2] * x[k + 2];
+            a3 += h[k + 3] * x[k + 3];
+        }
+        for (; k < taps; k++)
+            a0 += h[k] * x[k];
+        io[m * stride] = (a0 + a1) + (a2 + a3);
+    }
+
+    /* Keep the end of this window for the next one */
+    memmove(work, work + m_samples, history * sizeof(double));
+}
+
+}
@@ -0,0 +1,61 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#pragma once
+#include "arena.hpp"
+
+namespace source {
+struct config;
+}
+
+namespace audio {
+
+/* Low pass filter and downsampler in front of the fft. If only the bass is
+ * of interest, the fft doesn't need to run over the full rate signal, every
+ * factor-th sample of the filtered signal is enough. Only the kept outputs
+ * are computed, which is the cost of the polyphase form: each output is one
+ * dot product over the taps, taps_per_phase * factor of them.
+ * The filter state carries over between ticks, so the audio is filtered as
+ * one continuous stream */
+class decimator {
+    size_t m_factor = 1;
+    size_t m_samples = 0; /* Input window length, a multiple of the factor */
+    size_t m_channels = 0;
+
+    arena_array<double> m_taps; /* Reversed, so the dot product runs forward over the input */
+    arena_array<double> m_work; /* Per channel the last taps - 1 input samples, followed by the new window */
+
+public:
+    /* Largest factor that keeps high_cutoff_freq clear of aliasing and
+     * divides the window, or one if decimation is off or not possible */
+    static size_t pick_factor(const source::config *cfg);
+
+    void layout(arena &a, size_t factor, size_t samples, size_t channels);
+
+    /* Designs the filter, has to be called once the arena is committed */
+    void prepare();
+
+    size_t factor() const { return m_factor; }
+
+    /* Filters one window of samples, which are stride doubles apart, and writes
+     * the samples / factor outputs back to the start of it with the same stride */
+    void process(double *io, size_t stride, size_t channel);
+};
+
+}
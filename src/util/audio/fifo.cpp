@@ -91,11 +91,11 @@ bool fifo::open_fifo()
     if (m_fifo_fd)
         close(m_fifo_fd);
 
-    if (m_file_path && strlen(m_file_path) > 0) {
-        m_fifo_fd = open(m_file_path, O_RDONLY);
+    if (!m_file_path.empty()) {
+        m_fifo_fd = open(m_file_path.c_str(), O_RDONLY);
 
         if (m_fifo_fd < 0) {
-            warn("Failed to open fifo '%s'", m_file_path);
+            warn("Failed to open fifo '%s'", m_file_path.c_str());
         } else {
             auto flags = fcntl(m_fifo_fd, F_GETFL, 0);
             auto ret = fcntl(m_fifo_fd, F_SETFL, flags | O_NONBLOCK);
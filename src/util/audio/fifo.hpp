@@ -17,12 +17,13 @@
  *************************************************************************/
 
 #include "audio_source.hpp"
+#include <string>
 
 namespace audio {
 class fifo : public audio_source {
 #ifdef LINUX
 private:
-    const char *m_file_path = nullptr;
+    std::string m_file_path;
     int m_fifo_fd = 0;
     bool open_fifo();
 
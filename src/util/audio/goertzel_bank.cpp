@@ -0,0 +1,114 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#include "goertzel_bank.hpp"
+#include "../util.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace audio {
+
+/* Filters per group, they're run side by side to hide the latency of each one */
+static const size_t group = 4;
+
+void goertzel_bank::layout(arena &a, size_t max_filters)
+{
+    const size_t padded = (max_filters + group - 1) / group * group;
+    m_bins = a.alloc_array<uint32_t>(padded);
+    m_coeff = a.alloc_array<double>(padded);
+    m_filters = 0;
+}
+
+void goertzel_bank::prepare(size_t samples)
+{
+    m_filters = 0;
+    m_samples = samples;
+    std::fill(m_coeff.begin(), m_coeff.end(), 0.0);
+}
+
+bool goertzel_bank::add(uint32_t bin)
+{
+    if (m_filters > 0 && bin <= m_bins[m_filters - 1])
+        return true;
+    if (m_filters >= m_bins.size())
+        return false;
+    m_bins[m_filters] = bin;
+    m_coeff[m_filters] = 2.0 * std::cos(2.0 * M_PI * bin / m_samples);
+    m_filters++;
+    return true;
+}
+
+void goertzel_bank::execute(const double *input, size_t stride, fftw_complex *out) const
+{
+    const double *coeff = m_coeff.data();
+
+    /* Each filter depends on its previous step, so four of them run at once with
+     * their state in registers. The padding filters are computed and dropped */
+    for (size_t k = 0; k < m_filters; k += group) {
+        const double c0 = coeff[k], c1 = coeff[k + 1], c2 = coeff[k + 2], c3 = coeff[k + 3];
+        double a0 = 0, a1 = 0, a2 = 0, a3 = 0; /* s[n - 1] */
+        double b0 = 0, b1 = 0, b2 = 0, b3 = 0; /* s[n - 2] */
+
+        for (size_t n = 0; n < m_samples; n++) {
+            const double x = input[n * stride];
+            const double s0 = x + c0 * a0 - b0, s1 = x + c1 * a1 - b1;
+            const double s2 = x + c2 * a2 - b2, s3 = x + c3 * a3 - b3;
+            b0 = a0, b1 = a1, b2 = a2, b3 = a3;
+            a0 = s0, a1 = s1, a2 = s2, a3 = s3;
+        }
+
+        /* |X(w)|^2 = s1^2 + s2^2 - 2cos(w) s1 s2, the phase isn't needed */
+        const double a[group] = {a0, a1, a2, a3}, b[group] = {b0, b1, b2, b3};
+        for (size_t j = 0; j < group && k + j < m_filters; j++) {
+            const double power = a[j] * a[j] + b[j] * b[j] - coeff[k + j] * a[j] * b[j];
+            out[m_bins[k + j]][0] = std::sqrt(UTIL_MAX(power, 0.0));
+            out[m_bins[k + j]][1] = 0.0;
+        }
+    }
+}
+
+/* Relative cost of an fftw transform per sample. A radix two pass costs about
+ * one unit, a pass of an odd radix p about p units. Odd lengths can't be done
+ * as a complex transform of half the length, which doubles their cost */
+static double fft_cost(size_t samples)
+{
+    double cost = 0.0;
+    const bool odd = samples % 2;
+    for (size_t p = 2; samples > 1; p++) {
+        while (samples % p == 0) {
+            cost += p == 2 ? 1.0 : static_cast<double>(p);
+            samples /= p;
+        }
+        /* Large prime factors fall back to slower algorithms, treat them alike */
+        if (p * p > samples && samples > 1) {
+            cost += static_cast<double>(samples);
+            break;
+        }
+    }
+    return odd ? cost * 2.0 : cost;
+}
+
+bool goertzel_bank::cheaper_than_fft(size_t filters, size_t samples)
+{
+    if (samples < 2)
+        return false;
+    const size_t padded = (filters + group - 1) / group * group;
+    return padded * constants::goertzel_cost < fft_cost(samples);
+}
+
+}
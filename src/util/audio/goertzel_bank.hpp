@@ -0,0 +1,59 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#pragma once
+#include "arena.hpp"
+#include <fftw3.h>
+
+namespace audio {
+
+/* Bank of Goertzel filters, one for each fft bin the bar mapping reads. The
+ * linear and log scale only read a few of the lowest bins with few bars, so
+ * computing just those can be cheaper than transforming the whole window.
+ * The magnitudes are written in the layout fftw uses, so the bar code reads
+ * them the same way and gives the same bars */
+class goertzel_bank {
+    size_t m_filters = 0; /* Filters in use */
+    size_t m_samples = 0; /* Window length the filters are tuned for */
+
+    /* Bin and 2cos(w) per filter, padded to groups of four, see execute() */
+    arena_array<uint32_t> m_bins;
+    arena_array<double> m_coeff;
+
+public:
+    /* Reserves room for up to max_filters filters */
+    void layout(arena &a, size_t max_filters);
+
+    /* Drops all filters and tunes the next ones for windows of the given length */
+    void prepare(size_t samples);
+    /* Adds a filter for a bin, bins have to be added in ascending order and repeats
+     * are ignored. Returns false if there's no room left */
+    bool add(uint32_t bin);
+
+    size_t filters() const { return m_filters; }
+
+    /* Runs one window of real samples, which are stride doubles apart, through every
+     * filter and writes the magnitude of each bin to the real part of its output bin.
+     * Bins without a filter are left alone */
+    void execute(const double *input, size_t stride, fftw_complex *out) const;
+
+    /* Whether the bank is cheaper than an fft over the same window, see constants::goertzel_cost */
+    static bool cheaper_than_fft(size_t filters, size_t samples);
+};
+
+}
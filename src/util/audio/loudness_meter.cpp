@@ -0,0 +1,160 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "loudness_meter.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace audio {
+
+constexpr size_t loudness_meter::momentary_blocks;
+constexpr size_t loudness_meter::short_blocks;
+constexpr size_t loudness_meter::oversampling;
+constexpr size_t loudness_meter::phase_taps;
+
+static double to_db(double power_ratio, double offset = 0.0)
+{
+    if (power_ratio <= 0)
+        return constants::meter_floor;
+    return UTIL_MAX(offset + 10 * log10(power_ratio), constants::meter_floor);
+}
+
+void loudness_meter::reset(double sample_rate)
+{
+    /* BS.1770 K-weighting for any rate, the same prototype the 48 kHz coefficients come from */
+    double k = tan(M_PI * 1681.974450955533 / sample_rate);
+    const double q = 0.7071752369554196;
+    const double vh = pow(10.0, 3.999843853973347 / 20.0);
+    const double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    m_stage[0] = {(vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                  2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+
+    k = tan(M_PI * 38.13547087602444 / sample_rate);
+    const double q_hp = 0.5003270373238773;
+    a0 = 1.0 + k / q_hp + k * k;
+    m_stage[1] = {1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q_hp + k * k) / a0};
+
+    /* Blackman windowed sinc, cut off at the original nyquist. Every phase
+     * is normalized to unity gain, so a dc signal reads the same at all phases */
+    const size_t taps = oversampling * phase_taps;
+    for (size_t p = 0; p < oversampling; p++) {
+        double sum = 0;
+        for (size_t j = 0; j < phase_taps; j++) {
+            const size_t n = j * oversampling + p;
+            const double x = (n - (taps - 1) / 2.0) / oversampling;
+            const double w = 0.42 - 0.5 * cos(2 * M_PI * n / (taps - 1)) + 0.08 * cos(4 * M_PI * n / (taps - 1));
+            m_phases[p][j] = (x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x)) * w;
+            sum += m_phases[p][j];
+        }
+        for (size_t j = 0; j < phase_taps; j++)
+            m_phases[p][j] /= sum;
+    }
+
+    memset(m_z, 0, sizeof(m_z));
+    memset(m_blocks, 0, sizeof(m_blocks));
+    memset(m_history, 0, sizeof(m_history));
+    m_head = m_filled = m_history_pos = m_block_samples = 0;
+    m_momentary_sum = m_short_sum = m_block_energy = 0;
+    m_block_length = UTIL_MAX(static_cast<size_t>(lround(sample_rate / 10)), 1);
+
+    std::fill(std::begin(m_levels.rms), std::end(m_levels.rms), constants::meter_floor);
+    std::fill(std::begin(m_levels.peak), std::end(m_levels.peak), constants::meter_floor);
+    std::fill(std::begin(m_levels.true_peak), std::end(m_levels.true_peak), constants::meter_floor);
+    m_levels.momentary = m_levels.short_term = constants::meter_floor;
+}
+
+void loudness_meter::finish_block()
+{
+    const double energy = m_block_energy / m_block_length;
+    m_short_sum += energy - m_blocks[m_head];
+    m_momentary_sum += energy - m_blocks[(m_head + short_blocks - momentary_blocks) % short_blocks];
+    m_blocks[m_head] = energy;
+    m_head = (m_head + 1) % short_blocks;
+    m_filled = UTIL_MIN(m_filled + 1, short_blocks);
+    m_block_energy = 0;
+    m_block_samples = 0;
+
+    /* Rounding errors of the running sums don't build up past one lap */
+    if (m_head == 0) {
+        m_short_sum = m_momentary_sum = 0;
+        for (size_t i = 0; i < short_blocks; i++) {
+            m_short_sum += m_blocks[i];
+            if (i >= short_blocks - momentary_blocks)
+                m_momentary_sum += m_blocks[i];
+        }
+    }
+
+    /* Both channels are weighted with one, -0.691 makes a full scale 997 Hz sine in one channel read -3.01 LUFS */
+    m_levels.momentary = to_db(m_momentary_sum / UTIL_MIN(m_filled, momentary_blocks), -0.691);
+    m_levels.short_term = to_db(m_short_sum / m_filled, -0.691);
+}
+
+void loudness_meter::process(const pcm_stereo_sample *samples, size_t count)
+{
+    const double scale = 1.0 / 32768.0;
+    double peak[2] = {0, 0}, true_peak[2] = {0, 0}, square[2] = {0, 0};
+
+    for (size_t i = 0; i < count; i++) {
+        double x[2] = {samples[i].l * scale, samples[i].r * scale};
+
+        /* The loops over both channels are what gets vectorized */
+        double y[2] = {x[0], x[1]};
+        for (size_t s = 0; s < 2; s++) {
+            const biquad &f = m_stage[s];
+            for (size_t c = 0; c < 2; c++) {
+                const double in = y[c];
+                y[c] = f.b0 * in + m_z[s][0][c];
+                m_z[s][0][c] = f.b1 * in - f.a1 * y[c] + m_z[s][1][c];
+                m_z[s][1][c] = f.b2 * in - f.a2 * y[c];
+            }
+        }
+
+        m_history_pos = (m_history_pos + phase_taps - 1) % phase_taps;
+        for (size_t c = 0; c < 2; c++) {
+            m_history[c][m_history_pos] = m_history[c][m_history_pos + phase_taps] = x[c];
+            peak[c] = UTIL_MAX(peak[c], fabs(x[c]));
+            square[c] += x[c] * x[c];
+            m_block_energy += y[c] * y[c];
+        }
+
+        /* Newest sample first, it meets the first tap of every phase */
+        for (size_t p = 0; p < oversampling; p++) {
+            double out[2] = {0, 0};
+            for (size_t j = 0; j < phase_taps; j++) {
+                out[0] += m_phases[p][j] * m_history[0][m_history_pos + j];
+                out[1] += m_phases[p][j] * m_history[1][m_history_pos + j];
+            }
+            true_peak[0] = UTIL_MAX(true_peak[0], fabs(out[0]));
+            true_peak[1] = UTIL_MAX(true_peak[1], fabs(out[1]));
+        }
+
+        if (++m_block_samples == m_block_length)
+            finish_block();
+    }
+
+    for (size_t c = 0; c < 2; c++) {
+        m_levels.peak[c] = to_db(peak[c] * peak[c]);
+        /* The interpolation can't undershoot the samples themselves */
+        m_levels.true_peak[c] = to_db(UTIL_MAX(true_peak[c], peak[c]) * UTIL_MAX(true_peak[c], peak[c]));
+        m_levels.rms[c] = count ? to_db(square[c] / count) : constants::meter_floor;
+    }
+}
+
+}
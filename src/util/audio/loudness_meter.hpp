@@ -0,0 +1,79 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#pragma once
+#include "../util.hpp"
+
+namespace audio {
+
+/* Sample peak, true peak and rms of every processed window plus the EBU R128
+ * momentary (400 ms) and short-term (3 s) loudness of the stream. The two
+ * channels run in lock-step through the same filters, so the per sample work
+ * is done on pairs. State carries over between calls, the audio is measured
+ * as one continuous stream */
+class loudness_meter {
+public:
+    static constexpr size_t momentary_blocks = 4; /* 100 ms blocks */
+    static constexpr size_t short_blocks = 30;
+    static constexpr size_t oversampling = 4;
+    static constexpr size_t phase_taps = 12; /* Taps per phase of the true peak interpolator */
+
+    /* All in dB, clamped to constants::meter_floor */
+    struct levels {
+        double rms[2];
+        double peak[2];
+        double true_peak[2];
+        double momentary; /* LUFS */
+        double short_term;
+    };
+
+private:
+    /* K-weighting, a high shelf followed by a high pass, in transposed direct form II */
+    struct biquad {
+        double b0, b1, b2, a1, a2;
+    };
+    biquad m_stage[2];
+    double m_z[2][2][2]; /* Stage, delay, channel */
+
+    /* Mean squares of the last short_blocks blocks, the running sums are exact
+     * again every time the ring wraps */
+    double m_blocks[short_blocks];
+    size_t m_head = 0, m_filled = 0;
+    double m_momentary_sum = 0, m_short_sum = 0;
+    size_t m_block_length = 1, m_block_samples = 0;
+    double m_block_energy = 0;
+
+    /* Polyphase interpolator, the history is stored twice so every window is contiguous */
+    double m_phases[oversampling][phase_taps];
+    double m_history[2][phase_taps * 2];
+    size_t m_history_pos = 0;
+
+    levels m_levels;
+
+    void finish_block();
+
+public:
+    /* Designs the filters for the rate and clears all state */
+    void reset(double sample_rate);
+    void process(const pcm_stereo_sample *samples, size_t count);
+
+    const levels &get() const { return m_levels; }
+};
+
+}
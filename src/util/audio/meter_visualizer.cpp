@@ -0,0 +1,100 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "meter_visualizer.hpp"
+#include "../../source/visualizer_source.hpp"
+
+namespace audio {
+
+meter_visualizer::meter_visualizer(source::config *cfg) : audio_visualizer(cfg) {}
+
+void meter_visualizer::update(uint32_t dirty)
+{
+    audio_visualizer::update(dirty);
+    /* The audio source may have changed the rate */
+    if (m_rate != m_cfg->sample_rate) {
+        m_rate = m_cfg->sample_rate;
+        m_meter.reset(m_rate);
+    }
+
+    /* The source resets cx & cy on every update */
+    m_cfg->cx = BAR_COUNT * (m_cfg->bar_width + m_cfg->bar_space) - m_cfg->bar_space;
+    m_cfg->cy = m_cfg->bar_height;
+}
+
+float meter_visualizer::to_height(double db) const
+{
+    double share = (db - constants::meter_floor) / -constants::meter_floor;
+    return UTIL_CLAMP(0.0, share, 1.0) * m_cfg->bar_height;
+}
+
+void meter_visualizer::tick(float seconds)
+{
+    if (!m_cfg->buffer)
+        return;
+
+    audio_visualizer::tick(seconds);
+    if (m_data_read) {
+        PROFILE_SCOPE(m_cfg->profiler, stats::ST_INPUT);
+        m_meter.process(m_cfg->buffer, m_cfg->sample_size);
+        m_stale = false;
+    } else if (!m_stale) {
+        /* Without input the levels read as silence, so the bars fall and
+         * the loudness windows don't hold on to old audio once it resumes */
+        m_meter.reset(m_rate);
+        m_stale = true;
+    }
+
+    /* Rises immediately, falls with the gravity */
+    const auto &levels = m_meter.get();
+    const float gravity = m_cfg->gravity;
+    const double targets[BAR_COUNT] = {levels.rms[0], levels.rms[1], levels.momentary, levels.short_term};
+    for (size_t i = 0; i < BAR_COUNT; i++)
+        m_heights[i] = UTIL_MAX(to_height(targets[i]), m_heights[i] * gravity);
+    for (size_t c = 0; c < 2; c++) {
+        m_peaks[c] = UTIL_MAX(to_height(levels.peak[c]), m_peaks[c] * gravity);
+        m_true_peaks[c] = UTIL_MAX(to_height(levels.true_peak[c]), m_true_peaks[c] * gravity);
+    }
+}
+
+void meter_visualizer::draw_rectangle(float x, float y, float h)
+{
+    gs_matrix_push();
+    gs_matrix_translate3f(x, y, 0);
+    gs_draw_sprite(nullptr, 0, m_cfg->bar_width, UTIL_MAX(h, 1.f));
+    gs_matrix_pop();
+}
+
+void meter_visualizer::render(gs_effect_t *effect)
+{
+    UNUSED_PARAMETER(effect);
+    const float pitch = m_cfg->bar_width + m_cfg->bar_space;
+    const float bottom = m_cfg->bar_height;
+
+    for (size_t i = 0; i < BAR_COUNT; i++)
+        draw_rectangle(i * pitch, bottom - m_heights[i], m_heights[i]);
+
+    /* A two pixel line at the sample peak and a one pixel line at the true peak */
+    for (size_t c = 0; c < 2; c++) {
+        draw_rectangle(c * pitch, bottom - m_peaks[c], 2);
+        draw_rectangle(c * pitch, bottom - m_true_peaks[c], 1);
+    }
+}
+
+}
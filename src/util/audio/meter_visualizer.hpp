@@ -0,0 +1,48 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#pragma once
+#include "audio_visualizer.hpp"
+#include "loudness_meter.hpp"
+
+namespace audio {
+
+/* Level meter with four bars: the left and right rms with markers for the
+ * sample peak and the true peak, then momentary and short-term loudness.
+ * Everything is measured on the pcm buffer, there's no fft involved */
+class meter_visualizer : public audio_visualizer {
+    enum { BAR_LEFT, BAR_RIGHT, BAR_MOMENTARY, BAR_SHORT_TERM, BAR_COUNT };
+
+    loudness_meter m_meter;
+    uint32_t m_rate = 0;               /* The meter was set up for this rate */
+    bool m_stale = false;              /* The meter was reset since the last input */
+    float m_heights[BAR_COUNT] = {};   /* Falling with the gravity setting */
+    float m_peaks[2] = {}, m_true_peaks[2] = {};
+
+    float to_height(double db) const;
+    void draw_rectangle(float x, float y, float h);
+
+public:
+    explicit meter_visualizer(source::config *cfg);
+
+    void update(uint32_t dirty) override;
+    void tick(float seconds) override;
+    void render(gs_effect_t *effect) override;
+};
+}
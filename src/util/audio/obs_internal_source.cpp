@@ -22,6 +22,12 @@
 
 #define DEFAULT_AUDIO_BUF_MS 10
 #define MS_IN_S 100
+#define NS_IN_S 1000000000ull
+#define NS_IN_MS 1000000ull
+/* Timestamp jumps smaller than this are treated as jitter when syncing */
+#define SYNC_TOLERANCE_NS (5 * NS_IN_MS)
+/* Gaps larger than this aren't filled with silence, the buffer is restarted instead */
+#define SYNC_MAX_GAP_NS NS_IN_S
 
 namespace audio {
 
@@ -34,12 +40,12 @@ static void audio_capture(void *param, obs_source_t *src, const struct audio_dat
 
 obs_internal_source::obs_internal_source(source::config *cfg) : audio_source(cfg)
 {
-    circlebuf_init(&m_audio_data[0]);
-    circlebuf_init(&m_audio_data[1]);
+    for (auto &buf : m_audio_data)
+        circlebuf_init(&buf);
     update();
     // make sure that the buffer is empty on startup
-    memset(m_audio_buf[0], 0, m_audio_buf_len * sizeof(float));
-    memset(m_audio_buf[1], 0, m_audio_buf_len * sizeof(float));
+    for (auto &buf : m_audio_buf)
+        memset(buf, 0, m_audio_buf_len * sizeof(float));
 }
 
 obs_internal_source::~obs_internal_source()
@@ -54,44 +60,146 @@ obs_internal_source::~obs_internal_source()
         obs_weak_source_release(m_capture_source);
     }
 
-    for (size_t i = 0; i < 2; i++) {
+    for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
         circlebuf_free(&m_audio_data[i]);
         bfree(m_audio_buf[i]);
     }
+    bfree(m_mix_buf[0]);
+    bfree(m_mix_buf[1]);
 }
 
 void obs_internal_source::capture(obs_source_t *src, const struct audio_data *data, bool muted)
 {
-    m_cfg->value_mutex.lock();
+    std::lock_guard<std::mutex> lock(m_data_mutex);
 
     if (m_max_capture_frames < data->frames)
         m_max_capture_frames = data->frames;
 
     size_t expected = m_max_capture_frames * sizeof(float);
 
+    /* When synced to video the tick will throw away old audio by itself,
+     * so only make sure that the buffer can't grow indefinitely */
+    size_t limit = m_sync ? m_sample_rate * sizeof(float) : expected * 2;
+
     if (expected) {
-        if (m_audio_data[0].size > expected * 2) {
-            for (auto &buf : m_audio_data) {
-                circlebuf_pop_front(&buf, nullptr, expected);
-            }
+        if (m_sync)
+            sync_timestamp(data->timestamp);
+        else if (m_audio_data[0].size == 0)
+            m_front_ts = data->timestamp;
+
+        if (m_audio_data[0].size > limit) {
+            pop_frames(m_max_capture_frames);
+            m_cfg->health.overruns++;
+            m_cfg->health.dropped_frames += m_max_capture_frames;
         }
 
         if (muted) {
-            for (size_t i = 0; i < UTIL_MIN(m_num_channels, 2); i++) {
+            for (size_t i = 0; i < m_num_channels; i++) {
                 circlebuf_push_back_zero(&m_audio_data[i], data->frames * sizeof(float));
             }
         } else {
-            for (size_t i = 0; i < UTIL_MIN(m_num_channels, 2); i++) {
+            for (size_t i = 0; i < m_num_channels; i++) {
                 circlebuf_push_back(&m_audio_data[i], data->data[i], data->frames * sizeof(float));
             }
         }
     }
 
+    m_last_capture_ts = data->timestamp;
+    m_last_capture_frames = data->frames;
+
 #ifdef LINUX
-    if (m_cfg->auto_clear)
+    if (m_auto_clear)
         m_last_capture = os_gettime_ns();
 #endif
-    m_cfg->value_mutex.unlock();
+}
+
+void obs_internal_source::pop_frames(size_t frames)
+{
+    for (auto &buf : m_audio_data)
+        circlebuf_pop_front(&buf, nullptr, UTIL_MIN(frames * sizeof(float), buf.size));
+    m_front_ts += frames_to_ns(frames);
+}
+
+void obs_internal_source::sync_timestamp(uint64_t ts)
+{
+    if (m_audio_data[0].size == 0) {
+        m_front_ts = ts;
+        return;
+    }
+
+    /* Where the new data should start if the audio was continuous */
+    uint64_t expected = m_front_ts + frames_to_ns(m_audio_data[0].size / sizeof(float));
+
+    if (ts > expected + SYNC_TOLERANCE_NS && ts - expected < SYNC_MAX_GAP_NS) {
+        /* Fill the gap with silence to keep the timeline continuous */
+        size_t gap = ns_to_frames(ts - expected);
+        for (size_t i = 0; i < m_num_channels; i++)
+            circlebuf_push_back_zero(&m_audio_data[i], gap * sizeof(float));
+    } else if (ts > expected + SYNC_TOLERANCE_NS || ts + SYNC_TOLERANCE_NS < expected) {
+        /* Too far off or going backwards, start over */
+        for (auto &buf : m_audio_data)
+            circlebuf_pop_front(&buf, nullptr, buf.size);
+        m_front_ts = ts;
+    }
+}
+
+bool obs_internal_source::read_synced(size_t data_size)
+{
+    size_t len = m_audio_buf_len;
+    uint64_t window_end = obs_get_video_frame_time() - m_lookahead;
+    uint64_t window_start = window_end - frames_to_ns(len);
+
+    /* Throw away everything before the window */
+    if (m_audio_data[0].size > 0 && m_front_ts < window_start)
+        pop_frames(UTIL_MIN(ns_to_frames(window_start - m_front_ts), m_audio_data[0].size / sizeof(float)));
+
+    size_t buffered = m_audio_data[0].size / sizeof(float);
+    if (buffered == 0 || m_front_ts >= window_end) {
+        for (auto &buf : m_audio_buf)
+            memset(buf, 0, data_size);
+        debug("No audio for video frame time");
+        return false;
+    }
+
+    /* If the audio starts within the window pad the start with silence */
+    size_t lead = m_front_ts > window_start ? UTIL_MIN(ns_to_frames(m_front_ts - window_start), len) : 0;
+    size_t avail = UTIL_MIN(buffered, len - lead);
+
+    for (size_t i = 0; i < m_num_channels; i++) {
+        memset(m_audio_buf[i], 0, data_size);
+        circlebuf_peek_front(&m_audio_data[i], m_audio_buf[i] + lead, avail * sizeof(float));
+    }
+
+    m_cfg->health.add_latency(os_gettime_ns() - window_end);
+    return true;
+}
+
+bool obs_internal_source::read_fifo(size_t data_size)
+{
+    if (m_audio_data[0].size < data_size) {
+        /* Clear buffers */
+        for (auto &buf : m_audio_buf)
+            memset(buf, 0, data_size);
+        debug("No Data in circle buffer");
+        return false;
+    }
+
+    for (size_t i = 0; i < m_num_channels; i++) {
+        circlebuf_pop_front(&m_audio_data[i], m_audio_buf[i], data_size);
+    }
+    m_front_ts += frames_to_ns(m_audio_buf_len);
+
+    /* The window we just read ends where the audio still left in the
+     * buffer starts, which is that much older than the last capture */
+    if (m_last_capture_ts && m_sample_rate) {
+        uint64_t window_end = m_last_capture_ts + frames_to_ns(m_last_capture_frames);
+        uint64_t buffered = frames_to_ns(m_audio_data[0].size / sizeof(float));
+        uint64_t now = os_gettime_ns();
+
+        if (window_end > buffered && now > window_end - buffered)
+            m_cfg->health.add_latency(now - (window_end - buffered));
+    }
+    return true;
 }
 
 bool obs_internal_source::tick(float seconds)
@@ -135,41 +243,80 @@ bool obs_internal_source::tick(float seconds)
         return false;
     }
 
-    if (m_audio_data[0].size < data_size) {
-        /* Clear buffers */
-        memset(m_audio_buf[0], 0, data_size);
-        memset(m_audio_buf[1], 0, data_size);
-        debug("No Data in circle buffer");
-        return false;
-    } else {
-        /* Otherwise copy & convert */
-        for (size_t i = 0; i < UTIL_MIN(m_num_channels, 2); i++) {
-            circlebuf_pop_front(&m_audio_data[i], m_audio_buf[i], data_size);
-        }
+    {
+        std::lock_guard<std::mutex> lock(m_data_mutex);
+        if (!(m_sync ? read_synced(data_size) : read_fifo(data_size)))
+            return false;
+    }
 
-        /* Convert to int16 */
-        for (size_t chan = 0; chan < UTIL_MIN(m_num_channels, 2); chan++) {
-            if (!m_audio_buf[chan])
-                continue;
+    apply_downmix();
 
-            for (uint32_t i = 0; i < m_audio_buf_len; i++) {
-                if (chan == 0) {
-                    m_cfg->buffer[i].l = static_cast<int16_t>(m_audio_buf[chan][i] * (UINT16_MAX / 2));
-                } else {
-                    m_cfg->buffer[i].r = static_cast<int16_t>(m_audio_buf[chan][i] * (UINT16_MAX / 2));
-                }
-            }
-        }
+    /* Convert to int16 */
+    for (uint32_t i = 0; i < m_audio_buf_len; i++) {
+        m_cfg->buffer[i].l = static_cast<int16_t>(UTIL_CLAMP(-1.f, m_mix_buf[0][i], 1.f) * (UINT16_MAX / 2));
+        m_cfg->buffer[i].r = static_cast<int16_t>(UTIL_CLAMP(-1.f, m_mix_buf[1][i], 1.f) * (UINT16_MAX / 2));
     }
 
     return true;
 }
 
+void obs_internal_source::apply_downmix()
+{
+    for (int out = 0; out < 2; out++) {
+        float *mix = m_mix_buf[out];
+        memset(mix, 0, m_audio_buf_len * sizeof(float));
+
+        /* One pass per contributing channel keeps the inner loop trivially vectorizable */
+        for (size_t chan = 0; chan < m_num_channels; chan++) {
+            const float weight = m_downmix[out][chan];
+            const float *in = m_audio_buf[chan];
+            if (weight == 0.f)
+                continue;
+            for (size_t i = 0; i < m_audio_buf_len; i++)
+                mix[i] += weight * in[i];
+        }
+    }
+}
+
+void obs_internal_source::build_downmix()
+{
+    memset(m_downmix, 0, sizeof(m_downmix));
+    if (m_num_channels == 0)
+        return;
+
+    /* obs orders channels FL, FR, FC, LFE, RL, RR, SL, SR, 2.1 has LFE third */
+    size_t front_right = m_num_channels > 1 ? 1 : 0;
+    int lfe = m_num_channels == 3 ? 2 : (m_num_channels >= 5 ? 3 : -1);
+
+    switch (m_cfg->downmix) {
+    case DM_STEREO:
+        m_downmix[0][0] = 1.f;
+        m_downmix[1][front_right] = 1.f;
+        break;
+    case DM_SUM_ALL:
+        for (size_t i = 0; i < m_num_channels; i++)
+            m_downmix[0][i] = m_downmix[1][i] = 1.f / m_num_channels;
+        break;
+    case DM_LFE:
+        if (lfe < 0)
+            debug("Output has no LFE channel");
+        else
+            m_downmix[0][lfe] = m_downmix[1][lfe] = 1.f;
+        break;
+    case DM_CHANNELS:
+        m_downmix[0][UTIL_MIN(m_cfg->downmix_left, m_num_channels - 1)] = 1.f;
+        m_downmix[1][UTIL_MIN(m_cfg->downmix_right, m_num_channels - 1)] = 1.f;
+        break;
+    }
+}
+
 void obs_internal_source::resize_audio_buf(size_t new_len)
 {
     m_audio_buf_len = new_len;
-    m_audio_buf[0] = static_cast<float *>(brealloc(m_audio_buf[0], new_len * sizeof(float)));
-    m_audio_buf[1] = static_cast<float *>(brealloc(m_audio_buf[1], new_len * sizeof(float)));
+    for (auto &buf : m_audio_buf)
+        buf = static_cast<float *>(brealloc(buf, new_len * sizeof(float)));
+    for (auto &buf : m_mix_buf)
+        buf = static_cast<float *>(brealloc(buf, new_len * sizeof(float)));
 }
 
 void obs_internal_source::update()
@@ -181,14 +328,29 @@ void obs_internal_source::update()
      */
     m_cfg->sample_size = m_cfg->sample_rate / 60;
     // FIXME see comment in visualizer_source.cpp: get_properties_for_visualiser()
-    /*if (m_cfg->log_freq_scale) {
+    /*if (m_cfg->freq_scale == FS_LOG) {
         if (m_cfg->log_freq_quality == LFQ_PRECISE) {
             m_cfg->sample_size *= defaults::log_freq_quality_precise_detail_mul;
         } else {
             m_cfg->sample_size *= defaults::log_freq_quality_fast_detail_mul;
         }
     }*/
-    m_num_channels = audio_output_get_channels(obs_get_audio());
+    {
+        std::lock_guard<std::mutex> lock(m_data_mutex);
+        m_num_channels = UTIL_MIN(audio_output_get_channels(obs_get_audio()), MAX_AUDIO_CHANNELS);
+        build_downmix();
+        m_sample_rate = m_cfg->sample_rate;
+        m_lookahead = m_cfg->sync_lookahead * NS_IN_MS;
+#ifdef LINUX
+        m_auto_clear = m_cfg->auto_clear;
+#endif
+        if (m_sync != m_cfg->sync_to_video) {
+            /* Buffered audio was collected with different rules, start fresh */
+            m_sync = m_cfg->sync_to_video;
+            for (auto &buf : m_audio_data)
+                circlebuf_pop_front(&buf, nullptr, buf.size);
+        }
+    }
     obs_weak_source_t *old = nullptr;
 
     if (m_cfg->audio_source_name.empty()) {
@@ -31,17 +31,45 @@ class obs_internal_source : public audio_source {
     size_t m_max_capture_frames = 0;
     uint8_t m_num_channels = 0;
     uint64_t m_capture_check_time = 0;
-    circlebuf m_audio_data[2]; /* Left & Right data from capture callback */
-    float *m_audio_buf[2]{};   /* Copy of captured audio */
+    circlebuf m_audio_data[MAX_AUDIO_CHANNELS]; /* One planar buffer per channel from capture callback */
+    float *m_audio_buf[MAX_AUDIO_CHANNELS]{};   /* Copy of captured audio */
+    float *m_mix_buf[2]{};                      /* Left & Right after downmixing */
     size_t m_audio_buf_len = 0;
+    /* Weight of each input channel for the left and right analysis channel */
+    float m_downmix[2][MAX_AUDIO_CHANNELS]{};
+    /* Timestamp and length of the most recent capture, used to estimate latency */
+    uint64_t m_last_capture_ts = 0;
+    uint32_t m_last_capture_frames = 0;
+    /* Timestamp of the first frame in m_audio_data */
+    uint64_t m_front_ts = 0;
+    uint32_t m_sample_rate = 0;
+    /* If set the analyzed window is aligned to the video frame time
+     * minus m_lookahead instead of just reading the oldest audio */
+    bool m_sync = false;
+    uint64_t m_lookahead = 0;
+    /* Guards the buffered audio and the values above, which are shared with
+     * the capture callback on the audio thread. Never held for longer than a copy */
+    std::mutex m_data_mutex;
 #ifdef LINUX
     /* Used to keep track of last audio capture callback to decide
 	 * whether audio playback has stopped to clear the buffer.
 	 * This usually is needed when JACK is used
 	 */
     uint64_t m_last_capture = 0;
+    bool m_auto_clear = false;
 #endif
     void resize_audio_buf(size_t new_len);
+    void build_downmix();
+    void apply_downmix();
+
+    uint64_t frames_to_ns(size_t frames) const { return m_sample_rate ? frames * 1000000000ull / m_sample_rate : 0; }
+    size_t ns_to_frames(uint64_t ns) const { return static_cast<size_t>(ns * m_sample_rate / 1000000000ull); }
+
+    void pop_frames(size_t frames);
+    /* Fills small gaps in the timeline with silence and restarts the buffer on large jumps */
+    void sync_timestamp(uint64_t ts);
+    bool read_synced(size_t data_size);
+    bool read_fifo(size_t data_size);
 
 public:
     obs_internal_source(source::config *cfg);
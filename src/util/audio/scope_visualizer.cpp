@@ -0,0 +1,139 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "scope_visualizer.hpp"
+#include "../../source/visualizer_source.hpp"
+
+namespace audio {
+
+scope_visualizer::scope_visualizer(source::config *cfg) : audio_visualizer(cfg)
+{
+    /* The columns follow the source width */
+    m_layout_deps = DIRTY_AUDIO | DIRTY_BARS | DIRTY_GEOMETRY;
+}
+
+void scope_visualizer::layout(arena &a)
+{
+    audio_visualizer::layout(a);
+    m_columns = m_cfg->cx;
+    m_low = a.alloc_array<int16_t>(m_columns * 2);
+    m_high = a.alloc_array<int16_t>(m_columns * 2);
+}
+
+size_t scope_visualizer::find_trigger(size_t limit) const
+{
+    /* The signal has to dip below the hysteresis first, so noise around zero doesn't trigger */
+    const int32_t hysteresis = constants::scope_trigger_hysteresis;
+    const pcm_stereo_sample *s = m_cfg->buffer;
+    bool armed = false;
+
+    for (size_t i = 0; i < limit; i++) {
+        int32_t v = m_cfg->stereo ? s[i].l : (s[i].l + s[i].r) / 2;
+        if (v < -hysteresis)
+            armed = true;
+        else if (armed && v >= 0)
+            return i;
+    }
+    return 0;
+}
+
+void scope_visualizer::decimate(size_t start, size_t span)
+{
+    const pcm_stereo_sample *s = m_cfg->buffer + start;
+    int16_t *low_l = m_low.data(), *high_l = m_high.data();
+    int16_t *low_r = low_l + m_columns, *high_r = high_l + m_columns;
+
+    /* Branch free inner loops, so they are vectorized */
+    for (size_t c = 0; c < m_columns; c++) {
+        const size_t first = c * span / m_columns;
+        const size_t last = UTIL_MAX((c + 1) * span / m_columns, first + 1);
+        int16_t lo_l = INT16_MAX, hi_l = INT16_MIN, lo_r = INT16_MAX, hi_r = INT16_MIN;
+
+        if (m_cfg->stereo) {
+            for (size_t i = first; i < last; i++) {
+                lo_l = UTIL_MIN(lo_l, s[i].l);
+                hi_l = UTIL_MAX(hi_l, s[i].l);
+                lo_r = UTIL_MIN(lo_r, s[i].r);
+                hi_r = UTIL_MAX(hi_r, s[i].r);
+            }
+        } else {
+            for (size_t i = first; i < last; i++) {
+                int16_t v = (s[i].l + s[i].r) / 2;
+                lo_l = UTIL_MIN(lo_l, v);
+                hi_l = UTIL_MAX(hi_l, v);
+            }
+        }
+
+        low_l[c] = lo_l;
+        high_l[c] = hi_l;
+        low_r[c] = lo_r;
+        high_r[c] = hi_r;
+    }
+}
+
+void scope_visualizer::tick(float seconds)
+{
+    if (!m_cfg->buffer || m_columns == 0)
+        return;
+
+    audio_visualizer::tick(seconds);
+
+    /* Shows half the buffer, the trigger is searched for in the other half */
+    PROFILE_SCOPE(m_cfg->profiler, stats::ST_INPUT);
+    const size_t span = m_cfg->sample_size / 2;
+    decimate(find_trigger(m_cfg->sample_size - span), span);
+}
+
+void scope_visualizer::draw_channel(size_t channel, float center, float amplitude)
+{
+    vertex_buffer &vb = m_verts[channel];
+    const int16_t *low = m_low.data() + channel * m_columns;
+    const int16_t *high = m_high.data() + channel * m_columns;
+    const float scale = amplitude / 32768.f;
+
+    /* The band between the lowest and highest sample of every column, at least a pixel high */
+    vb.begin();
+    for (size_t c = 0; c < m_columns; c++) {
+        float top = center - high[c] * scale;
+        float bottom = UTIL_MAX(center - low[c] * scale, top + 1.f);
+        vb.vertex2f(c, top);
+        vb.vertex2f(c, bottom);
+    }
+
+    gs_load_vertexbuffer(vb.end());
+    gs_draw(GS_TRISTRIP, 0, m_columns * 2);
+}
+
+void scope_visualizer::render(gs_effect_t *effect)
+{
+    UNUSED_PARAMETER(effect);
+    if (m_columns == 0)
+        return;
+
+    if (m_cfg->stereo) {
+        /* Left on top, right below, each gets half the height */
+        const float amplitude = m_cfg->bar_height / 4.f;
+        draw_channel(0, amplitude, amplitude);
+        draw_channel(1, m_cfg->bar_height / 2.f + m_cfg->stereo_space + amplitude, amplitude);
+    } else {
+        draw_channel(0, m_cfg->bar_height / 2.f, m_cfg->bar_height / 2.f);
+    }
+}
+
+}
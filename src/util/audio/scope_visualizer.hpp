@@ -0,0 +1,47 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#pragma once
+#include "audio_visualizer.hpp"
+#include "vertex_buffer.hpp"
+
+namespace audio {
+
+/* Time domain waveform. Reads the pcm buffer directly and reduces it to the
+ * lowest and highest sample of every pixel column, there's no fft involved */
+class scope_visualizer : public audio_visualizer {
+    size_t m_columns = 0;
+    arena_array<int16_t> m_low, m_high; /* Per column, the right channel follows the left one */
+    vertex_buffer m_verts[2];           /* Left & right */
+
+    /* First rising zero crossing within the first limit samples, 0 if there is none */
+    size_t find_trigger(size_t limit) const;
+    void decimate(size_t start, size_t span);
+    void draw_channel(size_t channel, float center, float amplitude);
+
+protected:
+    void layout(arena &a) override;
+
+public:
+    explicit scope_visualizer(source::config *cfg);
+
+    void tick(float seconds) override;
+    void render(gs_effect_t *effect) override;
+};
+}
@@ -0,0 +1,165 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "spectrogram_visualizer.hpp"
+#include "../../source/visualizer_source.hpp"
+
+namespace audio {
+
+spectrogram_visualizer::spectrogram_visualizer(source::config *cfg) : spectrum_visualizer(cfg) {}
+
+spectrogram_visualizer::~spectrogram_visualizer()
+{
+    if (m_ring || m_column || m_effect) {
+        obs_enter_graphics();
+        gs_texrender_destroy(m_ring);
+        if (m_column)
+            gs_texture_destroy(m_column);
+        gs_effect_destroy(m_effect);
+        obs_leave_graphics();
+    }
+}
+
+void spectrogram_visualizer::layout(arena &a)
+{
+    spectrum_visualizer::layout(a);
+    m_values = a.alloc_array<float>(m_cfg->detail);
+}
+
+void spectrogram_visualizer::update(uint32_t dirty)
+{
+    spectrum_visualizer::update(dirty);
+    /* One pixel per column, the source resets cx & cy on every update */
+    m_cfg->cx = m_cfg->spectrogram_history;
+    m_cfg->cy = m_cfg->bar_height;
+}
+
+void spectrogram_visualizer::tick(float seconds)
+{
+    spectrum_visualizer::tick(seconds);
+    m_column_pending = true;
+}
+
+bool spectrogram_visualizer::output_changed()
+{
+    return m_column_pending;
+}
+
+bool spectrogram_visualizer::own_effect() const
+{
+    return !m_effect_failed;
+}
+
+bool spectrogram_visualizer::load_effect()
+{
+    if (m_effect || m_effect_failed)
+        return m_effect;
+
+    char *file = obs_module_file("spectrogram.effect");
+    char *errors = nullptr;
+    if (file)
+        m_effect = gs_effect_create_from_file(file, &errors);
+
+    if (!m_effect) {
+        warn("Couldn't load spectrogram.effect, the spectrogram stays empty: %s", errors ? errors : "file not found");
+        m_effect_failed = true;
+    }
+    bfree(errors);
+    bfree(file);
+    return m_effect;
+}
+
+void spectrogram_visualizer::write_column()
+{
+    const uint32_t bins = m_cfg->detail;
+    const uint32_t history = m_cfg->spectrogram_history;
+
+    /* Low frequencies at the bottom, both channels are averaged. Stereo bars only reach half the height */
+    const float scale = 1.f / (m_cfg->stereo ? m_cfg->bar_height / 2 : m_cfg->bar_height);
+    for (uint32_t i = 0; i < bins; i++) {
+        double value = m_cfg->stereo ? (m_bars_left[i] + m_bars_right[i]) / 2 : m_bars_left[i];
+        m_values[bins - 1 - i] = UTIL_CLAMP(0.f, static_cast<float>(value) * scale, 1.f);
+    }
+
+    if (m_column && gs_texture_get_height(m_column) != bins) {
+        gs_texture_destroy(m_column);
+        m_column = nullptr;
+    }
+    if (!m_column)
+        m_column = gs_texture_create(1, bins, GS_R32F, 1, nullptr, GS_DYNAMIC);
+    gs_texture_set_image(m_column, reinterpret_cast<const uint8_t *>(m_values.data()), sizeof(float), false);
+
+    /* The ring keeps its contents between frames, only the new column is drawn over it */
+    gs_texrender_reset(m_ring);
+    if (!gs_texrender_begin(m_ring, history, bins))
+        return;
+
+    if (m_ring_cx != history || m_ring_cy != bins) {
+        struct vec4 clear;
+        vec4_zero(&clear);
+        gs_clear(GS_CLEAR_COLOR, &clear, 0.f, 0);
+        m_ring_cx = history;
+        m_ring_cy = bins;
+        m_head = 0;
+    }
+    m_head = (m_head + 1) % history;
+
+    gs_ortho(0.f, history, 0.f, bins, -100.f, 100.f);
+    gs_blend_state_push();
+    gs_enable_blending(false);
+
+    gs_effect_t *draw = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+    gs_effect_set_texture(gs_effect_get_param_by_name(draw, "image"), m_column);
+    gs_matrix_translate3f(m_head, 0, 0);
+    while (gs_effect_loop(draw, "Draw"))
+        gs_draw_sprite(m_column, 0, 1, bins);
+
+    gs_blend_state_pop();
+    gs_texrender_end(m_ring);
+}
+
+void spectrogram_visualizer::render(gs_effect_t *effect)
+{
+    UNUSED_PARAMETER(effect);
+    if (!load_effect() || m_bars_left.empty())
+        return;
+
+    if (!m_ring)
+        m_ring = gs_texrender_create(GS_R32F, GS_ZS_NONE);
+    if (m_column_pending) {
+        write_column();
+        m_column_pending = false;
+    }
+
+    gs_texture_t *ring = gs_texrender_get_texture(m_ring);
+    if (!ring || !m_ring_cx)
+        return;
+
+    struct vec4 color;
+    vec4_from_rgba(&color, m_cfg->color);
+
+    /* Shifted so the newest column ends up at the right edge */
+    gs_effect_set_texture(gs_effect_get_param_by_name(m_effect, "image"), ring);
+    gs_effect_set_vec4(gs_effect_get_param_by_name(m_effect, "color"), &color);
+    gs_effect_set_float(gs_effect_get_param_by_name(m_effect, "shift"), (m_head + 1) / float(m_ring_cx));
+    while (gs_effect_loop(m_effect, "Draw"))
+        gs_draw_sprite(ring, 0, m_cfg->cx, m_cfg->cy);
+}
+
+}
@@ -0,0 +1,54 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#pragma once
+#include "spectrum_visualizer.hpp"
+
+namespace audio {
+
+/* Scrolling spectrogram. The history lives in a ring texture on the gpu, every
+ * analysis frame only draws its one new column into it and the display shifts
+ * the texture coordinates by the write position, see data/spectrogram.effect */
+class spectrogram_visualizer : public spectrum_visualizer {
+    gs_texrender_t *m_ring = nullptr; /* One column per frame, one row per bar */
+    gs_texture_t *m_column = nullptr; /* The newest column, uploaded each frame */
+    gs_effect_t *m_effect = nullptr;
+    bool m_effect_failed = false;
+    uint32_t m_ring_cx = 0, m_ring_cy = 0; /* The ring is cleared after it was resized */
+    uint32_t m_head = 0;                   /* Column that was written last */
+    bool m_column_pending = false;         /* Set by tick(), a new column is written on the next render */
+    arena_array<float> m_values;           /* Bars of the column, normalized to the bar height */
+
+    bool load_effect();
+    void write_column();
+
+protected:
+    void layout(arena &a) override;
+
+public:
+    explicit spectrogram_visualizer(source::config *cfg);
+    ~spectrogram_visualizer() override;
+
+    void update(uint32_t dirty) override;
+    void tick(float seconds) override;
+    bool output_changed() override;
+    bool own_effect() const override;
+    void render(gs_effect_t *effect) override;
+};
+}
@@ -21,10 +21,13 @@
 #include "audio_source.hpp"
 #include <algorithm>
 #include <cmath>
-#include <numeric>
 
 namespace {
 
+/* FIXME hardcoded to 3 for now
+ * look at visualizer_source.cpp: get_properties_for_visualiser() */
+const int lanczos_window = 3;
+
 inline double logspace(double start, double end, uint32_t n, uint32_t N)
 {
     return start * std::pow(end / start, n / static_cast<double>(N - 1));
@@ -57,7 +60,7 @@ inline double lanczos(double t, const int window, uint32_t in_count, const doubl
 {
     double result = 0.0f;
     for (int i = static_cast<int>(t) - window + 1; i < static_cast<int>(t) + window; ++i) {
-        if (i < 0 || i > in_count)
+        if (i < 0 || i >= in_count)
             continue; // add nothing if we go out of available freq range
 
         result += in_mags[i] * lanczos_kernel(t - static_cast<double>(i), window);
@@ -72,38 +75,124 @@ namespace audio {
 spectrum_visualizer::spectrum_visualizer(source::config *cfg)
     : audio_visualizer(cfg),
       m_last_bar_count(0),
+      m_fft_size(0),
+      m_fft_rate(0),
       m_fftw_results(0),
       m_fftw_input_left(nullptr),
       m_fftw_input_right(nullptr),
       m_fftw_output_left(nullptr),
       m_fftw_output_right(nullptr),
-      m_fftw_plan_left(nullptr),
-      m_fftw_plan_right(nullptr),
-      m_silent_runs(0u)
+      m_fftw_plan(nullptr)
 {
+    m_layout_deps = DIRTY_AUDIO | DIRTY_FFT | DIRTY_BARS;
 }
 
 spectrum_visualizer::~spectrum_visualizer()
 {
-    bfree(m_fftw_input_left);
-    bfree(m_fftw_input_right);
-    bfree(m_fftw_output_left);
-    bfree(m_fftw_output_right);
+    std::lock_guard<std::mutex> lock(fftw_planner_mutex());
+    if (m_fftw_plan)
+        fftw_destroy_plan(m_fftw_plan);
+    delete[] m_rounded_bars;
+}
+
+size_t spectrum_visualizer::scaling_window_size() const
+{
+    if (m_cfg->sample_size == 0)
+        return 0;
+    return static_cast<size_t>(
+        ((constants::auto_scale_span * m_cfg->sample_rate) / (static_cast<double>(m_cfg->sample_size))) * 2.0);
+}
+
+void spectrum_visualizer::layout(arena &a)
+{
+    audio_visualizer::layout(a);
+    const size_t bars = m_cfg->detail + DEAD_BAR_OFFSET;
+    const size_t factor = decimator::pick_factor(m_cfg);
+    m_fft_size = m_cfg->sample_size / factor;
+    m_fft_rate = m_cfg->sample_rate / static_cast<double>(factor);
+    m_fftw_results = m_fft_size / 2 + 1;
+    m_decimator.layout(a, factor, m_cfg->sample_size, m_cfg->stereo ? 2 : 1);
+
+    /* Both channels live in one block, so they can be transformed with a single plan.
+     * The input is sized for the full window, decimation shortens it in place */
+    m_fftw_input_left = a.alloc<double>(m_cfg->sample_size * 2);
+    m_fftw_input_right = m_fftw_input_left + m_cfg->sample_size;
+    m_fftw_output_left = a.alloc<fftw_complex>(m_fftw_results * 2);
+    m_fftw_output_right = m_fftw_output_left + m_fftw_results;
+    m_fftw_magnitudes = a.alloc_array<double>(m_fftw_results);
+
+    m_bars_left = a.alloc_array<double>(bars);
+    m_bars_right = a.alloc_array<double>(bars);
+    m_bars_left_new = a.alloc_array<double>(bars);
+    m_bars_right_new = a.alloc_array<double>(bars);
+    m_bar_freq = a.alloc_array<double>(bars);
+    m_monstercat_smoothing_weights = a.alloc_array<double>(bars);
+    m_sgs_scratch = a.alloc_array<double>(bars);
+    m_drawn_heights = a.alloc_array<int32_t>(bars * 2);
+    /* One more than the window, it's trimmed before a new value is added */
+    m_previous_max_heights = ringv(a.alloc_array<double>(scaling_window_size() + 1));
+    m_low_cutoff_frequencies = a.alloc_array<uint32_t>(bars + 1);
+    m_high_cutoff_frequencies = a.alloc_array<uint32_t>(bars + 1);
+    m_frequency_constants_per_bin = a.alloc_array<double>(bars + 1);
+
+    if (m_cfg->freq_scale == FS_CQT)
+        m_cqt.layout(a, m_cfg, bars, m_cfg->stereo ? 2 : 1);
+    else if (m_cfg->detail <= m_cfg->filter_bank_bars)
+        m_bank.layout(a, bars + 2 * lanczos_window); /* Room for every bin the bars can read */
+}
+
+void spectrum_visualizer::on_layout()
+{
+    m_previous_max_heights.clear(); /* Force recomputing scaling */
+    m_last_bar_count = 0;           /* Force precalculated data refresh */
+
+    for (size_t i = 0; i < m_monstercat_smoothing_weights.size(); ++i)
+        m_monstercat_smoothing_weights[i] = std::pow(m_cfg->mcat_smoothing_factor, i);
+
+    /* The plan is bound to the buffers, so it has to be recreated whenever they might have moved */
+    {
+        std::lock_guard<std::mutex> lock(fftw_planner_mutex());
+        if (m_fftw_plan)
+            fftw_destroy_plan(m_fftw_plan);
+        int size = static_cast<int>(m_fft_size), distance = static_cast<int>(m_cfg->sample_size);
+        if (m_cfg->stereo && m_cfg->mid_side) {
+            /* Mid & side are packed into one complex signal, transformed in place and
+             * split up again in unpack_mid_side(), which is one fft instead of two */
+            auto *packed = reinterpret_cast<fftw_complex *>(m_fftw_input_left);
+            m_fftw_plan = fftw_plan_dft_1d(size, packed, packed, FFTW_FORWARD, FFTW_ESTIMATE);
+        } else {
+            m_fftw_plan = fftw_plan_many_dft_r2c(1, &size, m_cfg->stereo ? 2 : 1, m_fftw_input_left, nullptr, 1,
+                                                 distance, m_fftw_output_left, nullptr, 1,
+                                                 static_cast<int>(m_fftw_results), FFTW_ESTIMATE);
+        }
+    }
+
+    if (m_cfg->freq_scale == FS_CQT)
+        m_cqt.plan();
+    else
+        m_cqt.release();
+    m_decimator.prepare();
+
+    /* With very few bars, computing only the bins they read can be cheaper than the fft */
+    m_use_bank = false;
+    if (m_cfg->freq_scale != FS_CQT && m_cfg->detail <= m_cfg->filter_bank_bars) {
+        m_use_bank = tune_bank(m_cfg->detail + DEAD_BAR_OFFSET) &&
+                     goertzel_bank::cheaper_than_fft(m_bank.filters(), m_fft_size);
+        debug("Using %s for %u bars, %zu bins over %zu samples", m_use_bank ? "filter bank" : "fft", m_cfg->detail,
+              m_bank.filters(), m_fft_size);
+    }
 }
 
-void spectrum_visualizer::update()
+void spectrum_visualizer::update(uint32_t dirty)
 {
-    audio_visualizer::update();
-    m_monstercat_smoothing_weights.clear(); /* Force recomputing of smoothing */
-    m_previous_max_heights.clear();         /* Force recomputing scaling */
-    m_last_bar_count = 0;                   /* Force precalculated data refresh */
+    /* Rebuilds the arena and plan if the fft or bar layout changed */
+    audio_visualizer::update(dirty);
 
-    m_fftw_results = (size_t)m_cfg->sample_size / 2 + 1;
-    m_fftw_input_left = (double *)brealloc(m_fftw_input_left, sizeof(double) * m_cfg->sample_size);
-    m_fftw_input_right = (double *)brealloc(m_fftw_input_right, sizeof(double) * m_cfg->sample_size);
+    if (dirty & (DIRTY_BARS | DIRTY_COLOR))
+        update_export();
 
-    m_fftw_output_left = (fftw_complex *)brealloc(m_fftw_output_left, sizeof(fftw_complex) * m_fftw_results);
-    m_fftw_output_right = (fftw_complex *)brealloc(m_fftw_output_right, sizeof(fftw_complex) * m_fftw_results);
+    if (!(dirty & DIRTY_GEOMETRY))
+        return;
 
     if (m_cfg->rounded_corners) {
         m_circle_points.clear();
@@ -123,105 +212,284 @@ void spectrum_visualizer::update()
 
 void spectrum_visualizer::tick(float seconds)
 {
-    if (!m_cfg->buffer || !m_fftw_input_left)
+    if (!read_input(seconds))
         return;
 
-    if (m_sleeping) {
-        m_sleep_count += seconds;
-        if (m_sleep_count >= 0.25f) {
-            m_sleeping = false;
-            m_sleep_count = 0.f;
+    {
+        /* Transforms both channels at once in stereo mode */
+        PROFILE_SCOPE(m_cfg->profiler, stats::ST_FFT);
+        if (m_cfg->freq_scale == FS_CQT) {
+            m_cqt.execute(m_cfg->buffer, m_cfg->sample_size, m_cfg->stereo && m_cfg->mid_side);
+        } else if (m_use_bank && m_cfg->stereo && m_cfg->mid_side) {
+            /* Mid & side are interleaved, see prepare_fft_input() */
+            m_bank.execute(m_fftw_input_left, 2, m_fftw_output_left);
+            m_bank.execute(m_fftw_input_left + 1, 2, m_fftw_output_right);
+        } else if (m_use_bank) {
+            m_bank.execute(m_fftw_input_left, 1, m_fftw_output_left);
+            if (m_cfg->stereo)
+                m_bank.execute(m_fftw_input_right, 1, m_fftw_output_right);
+        } else {
+            fftw_execute(m_fftw_plan);
+            if (m_cfg->stereo && m_cfg->mid_side)
+                unpack_mid_side();
         }
-        return;
     }
 
+    finish_bars();
+}
+
+bool spectrum_visualizer::output_changed()
+{
+    /* Bars only move on screen once their height changed by a pixel */
+    bool changed = false;
+    for (size_t i = 0; i < m_bars_left.size(); i++) {
+        auto left = static_cast<int32_t>(round(m_bars_left[i]));
+        auto right = m_cfg->stereo ? static_cast<int32_t>(round(m_bars_right[i])) : 0;
+        if (m_drawn_heights[i * 2] != left || m_drawn_heights[i * 2 + 1] != right) {
+            m_drawn_heights[i * 2] = left;
+            m_drawn_heights[i * 2 + 1] = right;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool spectrum_visualizer::read_input(float seconds)
+{
+    if (!m_cfg->buffer || !m_fftw_input_left || !m_fftw_plan)
+        return false;
+
     audio_visualizer::tick(seconds);
 
-    const auto win_height = m_cfg->bar_height;
-    bool is_silent_left = true, is_silent_right = true;
+    /* While the gate is closed only the level is measured, the
+     * input is converted once the gate opens again */
+    const bool was_open = m_gate_open;
+    signal_level level;
+    if (was_open)
+        prepare_input(level);
+    else
+        measure_level(m_cfg->buffer, m_cfg->sample_size, m_cfg->stereo, level);
 
-    if (m_cfg->stereo && m_fftw_plan_right) {
-        is_silent_left = prepare_fft_input(m_cfg->buffer, m_cfg->sample_size, m_fftw_input_left, CM_LEFT);
-        is_silent_right = prepare_fft_input(m_cfg->buffer, m_cfg->sample_size, m_fftw_input_right, CM_RIGHT);
-    } else {
-        is_silent_left = prepare_fft_input(m_cfg->buffer, m_cfg->sample_size, m_fftw_input_left, CM_LEFT);
+    update_gate(level, seconds);
+    if (!m_gate_open) {
+        settle_bars();
+        export_bars();
+        return false;
     }
+    if (!was_open)
+        prepare_input(level);
+    return true;
+}
 
-    if (!(is_silent_left && is_silent_right)) {
-        m_silent_runs = 0;
-    } else {
-        ++m_silent_runs;
-    }
-
-    /* TODO make this a constant */
-    if (m_silent_runs < 30) {
-        auto height = win_height;
-        double grav = 1 - m_cfg->gravity;
-        m_fftw_plan_left = fftw_plan_dft_r2c_1d(static_cast<int>(m_cfg->sample_size), m_fftw_input_left,
-                                                m_fftw_output_left, FFTW_ESTIMATE);
-        if (!m_fftw_plan_left)
-            return;
-        if (m_cfg->stereo) {
-            m_fftw_plan_right = fftw_plan_dft_r2c_1d(static_cast<int>(m_cfg->sample_size), m_fftw_input_right,
-                                                     m_fftw_output_right, FFTW_ESTIMATE);
-            if (!m_fftw_plan_right) {
-                fftw_destroy_plan(m_fftw_plan_left);
-                return;
-            }
-            fftw_execute(m_fftw_plan_right);
-            height /= 2;
+void spectrum_visualizer::finish_bars()
+{
+    auto height = m_cfg->bar_height;
+    double grav = 1 - m_cfg->gravity;
+    if (m_cfg->stereo)
+        height /= 2;
+
+    create_spectrum_bars(m_fftw_output_left, m_fftw_results, height, m_cfg->detail + DEAD_BAR_OFFSET,
+                         &m_bars_left_new, 0);
+    if (m_cfg->stereo) {
+        create_spectrum_bars(m_fftw_output_right, m_fftw_results, height, m_cfg->detail + DEAD_BAR_OFFSET,
+                             &m_bars_right_new, 1);
+
+        for (size_t i = 0; i < m_bars_right.size(); i++) {
+            m_bars_right[i] = m_bars_right[i] * m_cfg->gravity + m_bars_right_new[i] * grav;
         }
+    }
 
-        fftw_execute(m_fftw_plan_left);
+    for (size_t i = 0; i < m_bars_left.size(); i++) {
+        m_bars_left[i] = m_bars_left[i] * m_cfg->gravity + m_bars_left_new[i] * grav;
+    }
+    export_bars();
+}
 
-        create_spectrum_bars(m_fftw_output_left, m_fftw_results, height, m_cfg->detail + DEAD_BAR_OFFSET,
-                             &m_bars_left_new);
-        if (m_cfg->stereo) {
-            create_spectrum_bars(m_fftw_output_right, m_fftw_results, height, m_cfg->detail + DEAD_BAR_OFFSET,
-                                 &m_bars_right_new);
+void spectrum_visualizer::prepare_input(signal_level &level)
+{
+    PROFILE_SCOPE(m_cfg->profiler, stats::ST_INPUT);
+    if (m_cfg->stereo && m_cfg->mid_side) {
+        prepare_fft_input(m_cfg->buffer, m_cfg->sample_size, m_fftw_input_left, CM_MID_SIDE, level);
+    } else if (m_cfg->stereo) {
+        prepare_fft_input(m_cfg->buffer, m_cfg->sample_size, m_fftw_input_left, CM_LEFT, level);
+        prepare_fft_input(m_cfg->buffer, m_cfg->sample_size, m_fftw_input_right, CM_RIGHT, level);
+    } else {
+        prepare_fft_input(m_cfg->buffer, m_cfg->sample_size, m_fftw_input_left, CM_LEFT, level);
+    }
 
-            m_bars_right.resize(m_bars_right_new.size(), 0.0);
-            for (size_t i = 0; i < m_bars_right.size(); i++) {
-                m_bars_right[i] = m_bars_right[i] * m_cfg->gravity + m_bars_right_new[i] * grav;
-            }
+    if (m_decimator.factor() > 1) {
+        if (m_cfg->stereo && m_cfg->mid_side) {
+            m_decimator.process(m_fftw_input_left, 2, 0);
+            m_decimator.process(m_fftw_input_left + 1, 2, 1);
+        } else {
+            m_decimator.process(m_fftw_input_left, 1, 0);
+            if (m_cfg->stereo)
+                m_decimator.process(m_fftw_input_right, 1, 1);
         }
+    }
+}
 
-        m_bars_left.resize(m_bars_left_new.size(), 0.0);
-        for (size_t i = 0; i < m_bars_left.size(); i++) {
-            m_bars_left[i] = m_bars_left[i] * m_cfg->gravity + m_bars_left_new[i] * grav;
+/* The level is accumulated as integers next to the conversion, integer
+ * sums can be reordered freely, so the loops vectorize */
+void spectrum_visualizer::prepare_fft_input(pcm_stereo_sample *buffer, uint32_t sample_size, double *fftw_input,
+                                            channel_mode channel_mode, signal_level &level)
+{
+    int32_t peak = 0;
+    int64_t energy = 0;
+
+    switch (channel_mode) {
+    case CM_MID_SIDE:
+        /* Interleaved mid & side pairs, which is the layout of a complex
+         * signal with mid as real and side as imaginary part */
+        for (auto i = 0u; i < sample_size; ++i) {
+            const int32_t l = buffer[i].l, r = buffer[i].r;
+            fftw_input[i * 2] = (l + r) * .5;
+            fftw_input[i * 2 + 1] = (l - r) * .5;
+            peak = UTIL_MAX(peak, UTIL_MAX(std::abs(l), std::abs(r)));
+            energy += int64_t(l) * l + int64_t(r) * r;
         }
-
-        fftw_destroy_plan(m_fftw_plan_left);
-        if (m_cfg->stereo)
-            fftw_destroy_plan(m_fftw_plan_right);
-    } else {
-        m_sleeping = true;
+        level.samples += sample_size * 2;
+        break;
+    case CM_LEFT:
+        for (auto i = 0u; i < sample_size; ++i) {
+            const int32_t v = buffer[i].l;
+            fftw_input[i] = v;
+            peak = UTIL_MAX(peak, std::abs(v));
+            energy += int64_t(v) * v;
+        }
+        level.samples += sample_size;
+        break;
+    case CM_RIGHT:
+        for (auto i = 0u; i < sample_size; ++i) {
+            const int32_t v = buffer[i].r;
+            fftw_input[i] = v;
+            peak = UTIL_MAX(peak, std::abs(v));
+            energy += int64_t(v) * v;
+        }
+        level.samples += sample_size;
+        break;
+    case CM_BOTH:
+        for (auto i = 0u; i < sample_size; ++i) {
+            const int32_t v = buffer[i].l + buffer[i].r;
+            fftw_input[i] = v;
+            peak = UTIL_MAX(peak, std::abs(v));
+            energy += int64_t(v) * v;
+        }
+        level.samples += sample_size;
+        break;
+    default:;
     }
+
+    level.peak = UTIL_MAX(level.peak, peak);
+    level.energy += energy;
 }
 
-bool spectrum_visualizer::prepare_fft_input(pcm_stereo_sample *buffer, uint32_t sample_size, double *fftw_input,
-                                            channel_mode channel_mode)
+void spectrum_visualizer::measure_level(const pcm_stereo_sample *buffer, uint32_t sample_size, bool stereo,
+                                        signal_level &level) const
 {
-    bool is_silent = true;
+    int32_t peak = 0;
+    int64_t energy = 0;
 
     for (auto i = 0u; i < sample_size; ++i) {
-        switch (channel_mode) {
-        case CM_LEFT:
-            fftw_input[i] = buffer[i].l;
-            break;
-        case CM_RIGHT:
-            fftw_input[i] = buffer[i].r;
-            break;
-        case CM_BOTH:
-            fftw_input[i] = buffer[i].l + buffer[i].r;
-            break;
+        const int32_t l = buffer[i].l, r = stereo ? buffer[i].r : 0;
+        peak = UTIL_MAX(peak, UTIL_MAX(std::abs(l), std::abs(r)));
+        energy += int64_t(l) * l + int64_t(r) * r;
+    }
+
+    level.peak = UTIL_MAX(level.peak, peak);
+    level.energy += energy;
+    level.samples += sample_size * (stereo ? 2 : 1);
+}
+
+void spectrum_visualizer::update_gate(const signal_level &level, float seconds)
+{
+    /* Opens on the peak, so a single transient wakes the visualizer up, but
+     * only closes once the rms stayed below the threshold minus the hysteresis,
+     * so clicks in an otherwise quiet noise floor don't keep it awake */
+    const double full_scale = 32768.0;
+    if (!m_gate_open) {
+        const double peak_db = level.peak ? 20.0 * std::log10(level.peak / full_scale) : -INFINITY;
+        if (peak_db >= m_cfg->gate_threshold) {
+            m_gate_open = true;
+            m_gate_quiet = 0.f;
+            m_resting = false;
         }
+        return;
+    }
 
-        if (is_silent && fftw_input[i] > 0)
-            is_silent = false;
+    const double mean_square = level.samples ? double(level.energy) / level.samples : 0.0;
+    const double rms_db = mean_square > 0 ? 10.0 * std::log10(mean_square / (full_scale * full_scale)) : -INFINITY;
+    if (rms_db < m_cfg->gate_threshold - m_cfg->gate_hysteresis) {
+        m_gate_quiet += seconds;
+        if (m_gate_quiet >= constants::gate_hold)
+            m_gate_open = false;
+    } else {
+        m_gate_quiet = 0.f;
     }
+}
+
+void spectrum_visualizer::settle_bars()
+{
+    if (m_resting)
+        return;
+
+    /* Same falloff as silence would have with the fft running */
+    bool moving = false;
+    for (doublev *bars : {&m_bars_left, &m_bars_right}) {
+        for (double &bar : *bars) {
+            bar *= m_cfg->gravity;
+            if (std::abs(bar) < 0.5)
+                bar = 0.0;
+            else
+                moving = true;
+        }
+    }
+    m_resting = !moving;
+}
+
+void spectrum_visualizer::update_export()
+{
+    /* Both only grow, fewer bars fit into them as they are */
+    if (!m_cfg->shm_export)
+        m_export.close();
+    else if (!m_export.is_open() || m_export.name() != m_cfg->shm_name || m_export.capacity() < m_cfg->detail)
+        m_export.open(m_cfg->shm_name, m_cfg->detail);
+
+    if (!m_cfg->stream)
+        m_stream.close();
+    else if (!m_stream.is_open() || m_stream.address() != m_cfg->stream_address ||
+             m_stream.wide() != m_cfg->stream_wide || m_stream.capacity() < m_cfg->detail)
+        m_stream.open(m_cfg->stream_address, m_cfg->stream_wide, m_cfg->detail);
+}
+
+void spectrum_visualizer::export_bars()
+{
+    if (!m_export.is_open() && !m_stream.is_open())
+        return;
 
-    return is_silent;
+    /* Same height as the bars have on screen, without the silent bars at the end */
+    const uint32_t height = m_cfg->stereo ? m_cfg->bar_height / 2 : m_cfg->bar_height;
+    const uint32_t bars = static_cast<uint32_t>(UTIL_MIN(m_cfg->detail, m_bars_left.size()));
+    const double *right = m_cfg->stereo ? m_bars_right.data() : nullptr;
+    m_export.publish(m_bars_left.data(), right, bars, height);
+    m_stream.publish(m_bars_left.data(), right, bars, height);
+}
+
+void spectrum_visualizer::unpack_mid_side()
+{
+    /* The in-place transform of mid + i * side is X, the spectra of the two
+     * real signals are M[k] = (X[k] + conj(X[N - k])) / 2 and
+     * S[k] = (X[k] - conj(X[N - k])) / 2i */
+    auto *x = reinterpret_cast<fftw_complex *>(m_fftw_input_left);
+    const size_t n = m_fft_size;
+
+    for (size_t k = 0; k < m_fftw_results; k++) {
+        const double *a = x[k], *b = x[(n - k) % n];
+        m_fftw_output_left[k][0] = (a[0] + b[0]) * .5;
+        m_fftw_output_left[k][1] = (a[1] - b[1]) * .5;
+        m_fftw_output_right[k][0] = (a[1] + b[1]) * .5;
+        m_fftw_output_right[k][1] = (b[0] - a[0]) * .5;
+    }
 }
 
 void spectrum_visualizer::smooth_bars(doublev *bars)
@@ -239,7 +507,8 @@ void spectrum_visualizer::smooth_bars(doublev *bars)
 
 void spectrum_visualizer::sgs_smoothing(doublev *bars)
 {
-    auto original_bars = *bars;
+    auto &original_bars = m_sgs_scratch;
+    std::copy(bars->begin(), bars->end(), original_bars.begin());
 
     auto smoothing_passes = m_cfg->sgs_passes;
     auto smoothing_points = m_cfg->sgs_points;
@@ -263,7 +532,7 @@ void spectrum_visualizer::sgs_smoothing(doublev *bars)
 
         // prepare for next pass
         if (pass < (smoothing_passes - 1)) {
-            original_bars = *bars;
+            std::copy(bars->begin(), bars->end(), original_bars.begin());
         }
     }
 }
@@ -272,14 +541,8 @@ void spectrum_visualizer::monstercat_smoothing(doublev *bars)
 {
     auto bars_length = static_cast<int64_t>(bars->size());
 
-    // re-compute weights if needed, this is a performance tweak to computer the
-    // smoothing considerably faster
-    if (m_monstercat_smoothing_weights.size() != bars->size()) {
-        m_monstercat_smoothing_weights.resize(bars->size());
-        for (auto i = 0u; i < bars->size(); ++i) {
-            m_monstercat_smoothing_weights[i] = std::pow(m_cfg->mcat_smoothing_factor, i);
-        }
-    }
+    // weights are precomputed in on_layout(), this is a performance tweak to
+    // compute the smoothing considerably faster
 
     // apply monstercat sytle smoothing
     // Since this type of smoothing smoothes the bars around it, doesn't make
@@ -309,88 +572,94 @@ void spectrum_visualizer::monstercat_smoothing(doublev *bars)
     }
 }
 
-gs_vertbuffer_t *spectrum_visualizer::make_rounded_rectangle(float height)
+gs_vertbuffer_t *spectrum_visualizer::make_rounded_rectangle(size_t bar, float height)
 {
-    gs_render_start(true);
+    /* One buffer per bar and channel, grown only if the bar count grows */
+    if (bar >= m_rounded_bar_count) {
+        delete[] m_rounded_bars;
+        m_rounded_bar_count = UTIL_MAX(m_bars_left.size() * 2, bar + 1);
+        m_rounded_bars = new vertex_buffer[m_rounded_bar_count];
+    }
+
+    vertex_buffer &vb = m_rounded_bars[bar];
+    vb.begin();
     int index = 0;
 
     // Top right
     for (int i = 0; i <= m_cfg->corner_points; i++) {
         auto &v = m_circle_points[index++];
         // We can't go outside the bounds
-        gs_vertex2f(UTIL_CLAMP(1, m_cfg->bar_width - (m_corner_radius - v.x), m_cfg->cx),
+        vb.vertex2f(UTIL_CLAMP(1, m_cfg->bar_width - (m_corner_radius - v.x), m_cfg->cx),
                     UTIL_CLAMP(1, m_corner_radius - v.y, m_cfg->cy));
-        gs_vertex2f(m_cfg->bar_width - m_corner_radius, m_corner_radius);
+        vb.vertex2f(m_cfg->bar_width - m_corner_radius, m_corner_radius);
     }
 
     // right filler
-    gs_vertex2f(m_cfg->bar_width, m_corner_radius);
-    gs_vertex2f(m_cfg->bar_width, height - m_corner_radius);
+    vb.vertex2f(m_cfg->bar_width, m_corner_radius);
+    vb.vertex2f(m_cfg->bar_width, height - m_corner_radius);
 
-    gs_vertex2f(m_cfg->bar_width - m_corner_radius, m_corner_radius);
-    gs_vertex2f(m_cfg->bar_width - m_corner_radius, height - m_corner_radius);
+    vb.vertex2f(m_cfg->bar_width - m_corner_radius, m_corner_radius);
+    vb.vertex2f(m_cfg->bar_width - m_corner_radius, height - m_corner_radius);
 
     // bottom right
     for (int i = 0; i <= m_cfg->corner_points; i++) {
         auto &v = m_circle_points[index++];
-        gs_vertex2f(UTIL_CLAMP(1, m_cfg->bar_width - (m_corner_radius - v.x), m_cfg->cx),
+        vb.vertex2f(UTIL_CLAMP(1, m_cfg->bar_width - (m_corner_radius - v.x), m_cfg->cx),
                     UTIL_CLAMP(1, height - (m_corner_radius + v.y), m_cfg->cy));
-        gs_vertex2f(m_cfg->bar_width - m_corner_radius, height - m_corner_radius);
+        vb.vertex2f(m_cfg->bar_width - m_corner_radius, height - m_corner_radius);
     }
 
     // bottom filler
-    gs_vertex2f(m_cfg->bar_width - m_corner_radius, height);
-    gs_vertex2f(m_corner_radius, height);
+    vb.vertex2f(m_cfg->bar_width - m_corner_radius, height);
+    vb.vertex2f(m_corner_radius, height);
 
-    gs_vertex2f(m_cfg->bar_width - m_corner_radius, height - m_corner_radius);
-    gs_vertex2f(m_corner_radius, height - m_corner_radius);
+    vb.vertex2f(m_cfg->bar_width - m_corner_radius, height - m_corner_radius);
+    vb.vertex2f(m_corner_radius, height - m_corner_radius);
 
     // bottom left
     for (int i = 0; i <= m_cfg->corner_points; i++) {
         auto &v = m_circle_points[index++];
-        gs_vertex2f(UTIL_CLAMP(1, m_corner_radius + v.x, m_cfg->cx),
+        vb.vertex2f(UTIL_CLAMP(1, m_corner_radius + v.x, m_cfg->cx),
                     UTIL_CLAMP(1, height - (m_corner_radius + v.y), m_cfg->cy));
-        gs_vertex2f(m_corner_radius, height - m_corner_radius);
+        vb.vertex2f(m_corner_radius, height - m_corner_radius);
     }
 
     // left filler
-    gs_vertex2f(1, height - m_corner_radius);
-    gs_vertex2f(1, m_corner_radius);
+    vb.vertex2f(1, height - m_corner_radius);
+    vb.vertex2f(1, m_corner_radius);
 
-    gs_vertex2f(m_corner_radius, height - m_corner_radius);
-    gs_vertex2f(m_corner_radius, m_corner_radius);
+    vb.vertex2f(m_corner_radius, height - m_corner_radius);
+    vb.vertex2f(m_corner_radius, m_corner_radius);
 
     // top left
     for (int i = 0; i <= m_cfg->corner_points; i++) {
         auto &v = m_circle_points[index++];
-        gs_vertex2f(UTIL_CLAMP(1, m_corner_radius + v.x, m_cfg->cx), UTIL_CLAMP(1, m_corner_radius - v.y, m_cfg->cy));
-        gs_vertex2f(m_corner_radius, m_corner_radius);
+        vb.vertex2f(UTIL_CLAMP(1, m_corner_radius + v.x, m_cfg->cx), UTIL_CLAMP(1, m_corner_radius - v.y, m_cfg->cy));
+        vb.vertex2f(m_corner_radius, m_corner_radius);
     }
 
     // top filler
-    gs_vertex2f(m_corner_radius, 1);
-    gs_vertex2f(m_cfg->bar_width - m_corner_radius, 1);
+    vb.vertex2f(m_corner_radius, 1);
+    vb.vertex2f(m_cfg->bar_width - m_corner_radius, 1);
 
-    gs_vertex2f(m_cfg->bar_width - m_corner_radius, m_corner_radius);
-    gs_vertex2f(m_corner_radius, m_corner_radius);
+    vb.vertex2f(m_cfg->bar_width - m_corner_radius, m_corner_radius);
+    vb.vertex2f(m_corner_radius, m_corner_radius);
 
     // Center filler
-    gs_vertex2f(m_cfg->bar_width - m_corner_radius, m_corner_radius);
-    gs_vertex2f(m_cfg->bar_width - m_corner_radius, height - m_corner_radius);
+    vb.vertex2f(m_cfg->bar_width - m_corner_radius, m_corner_radius);
+    vb.vertex2f(m_cfg->bar_width - m_corner_radius, height - m_corner_radius);
 
-    gs_vertex2f(m_corner_radius, height - m_corner_radius);
-    gs_vertex2f(m_corner_radius, m_corner_radius);
+    vb.vertex2f(m_corner_radius, height - m_corner_radius);
+    vb.vertex2f(m_corner_radius, m_corner_radius);
 
-    return gs_render_save();
+    return vb.end();
 }
 
 void spectrum_visualizer::apply_falloff(const doublev &bars, doublev *falloff_bars) const
 {
-    // Screen size has change which means previous falloff values are not valid
-    if (falloff_bars->size() != bars.size()) {
-        *falloff_bars = bars;
+    // Both are laid out with the same size, see layout()
+    if (falloff_bars->size() != bars.size())
         return;
-    }
 
     for (auto i = 0u; i < bars.size(); ++i) {
         // falloff should always by at least one
@@ -401,18 +670,21 @@ void spectrum_visualizer::apply_falloff(const doublev &bars, doublev *falloff_ba
 }
 
 void spectrum_visualizer::calculate_moving_average_and_std_dev(double new_value, size_t max_number_of_elements,
-                                                               doublev *old_values, double *moving_average,
+                                                               ringv *old_values, double *moving_average,
                                                                double *std_dev) const
 {
     if (old_values->size() > max_number_of_elements)
-        old_values->erase(old_values->begin());
+        old_values->pop_front(1);
 
     old_values->push_back(new_value);
 
-    auto sum = std::accumulate(old_values->begin(), old_values->end(), 0.0);
+    double sum = 0.0, squared_summation = 0.0;
+    for (size_t i = 0; i < old_values->size(); i++) {
+        const double v = (*old_values)[i];
+        sum += v;
+        squared_summation += v * v;
+    }
     *moving_average = sum / old_values->size();
-
-    auto squared_summation = std::inner_product(old_values->begin(), old_values->end(), old_values->begin(), 0.0);
     *std_dev = std::sqrt((squared_summation / old_values->size()) - std::pow(*moving_average, 2));
 }
 
@@ -425,8 +697,7 @@ void spectrum_visualizer::scale_bars(int32_t height, doublev *bars)
         const auto max_height_iter = std::max_element(bars->begin(), bars->end());
 
         // max number of elements to calculate for moving average
-        const auto max_number_of_elements = static_cast<size_t>(
-            ((constants::auto_scale_span * m_cfg->sample_rate) / (static_cast<double>(m_cfg->sample_size))) * 2.0);
+        const auto max_number_of_elements = scaling_window_size();
 
         double std_dev = 0.0;
         double moving_average = 0.0;
@@ -454,24 +725,24 @@ void spectrum_visualizer::scale_bars(int32_t height, doublev *bars)
 }
 
 void spectrum_visualizer::maybe_reset_scaling_window(double current_max_height, size_t max_number_of_elements,
-                                                     doublev *values, double *moving_average, double *std_dev)
+                                                     ringv *values, double *moving_average, double *std_dev)
 {
     const auto reset_window_size = (constants::auto_scaling_reset_window * max_number_of_elements);
     // Current max height is much larger than moving average, so throw away most
     // values re-calculate
     if (static_cast<double>(values->size()) > reset_window_size) {
         // get average over scaling window
-        auto average_over_reset_window =
-            std::accumulate(values->begin(), values->begin() + static_cast<int64_t>(reset_window_size), 0.0) /
-            reset_window_size;
+        double average_over_reset_window = 0.0;
+        for (size_t i = 0; i < static_cast<size_t>(reset_window_size); i++)
+            average_over_reset_window += (*values)[i];
+        average_over_reset_window /= reset_window_size;
 
         // if short term average very different from long term moving average,
         // reset window and re-calculate
         if (std::abs(average_over_reset_window - *moving_average) >
             (constants::deviation_amount_to_reset * (*std_dev))) {
-            values->erase(values->begin(),
-                          values->begin() + static_cast<int64_t>((static_cast<double>(values->size()) *
-                                                                  constants::auto_scaling_erase_percent)));
+            values->pop_front(
+                static_cast<size_t>(static_cast<double>(values->size()) * constants::auto_scaling_erase_percent));
 
             calculate_moving_average_and_std_dev(current_max_height, max_number_of_elements, values, moving_average,
                                                  std_dev);
@@ -480,9 +751,11 @@ void spectrum_visualizer::maybe_reset_scaling_window(double current_max_height,
 }
 
 void spectrum_visualizer::create_spectrum_bars(fftw_complex *fftw_output, size_t fftw_results, int32_t win_height,
-                                               uint32_t number_of_bars, doublev *bars)
+                                               uint32_t number_of_bars, doublev *bars, size_t channel)
 {
-    if (m_cfg->log_freq_scale) {
+    if (m_cfg->freq_scale == FS_CQT) {
+        // the kernels are built with the layout
+    } else if (m_cfg->freq_scale == FS_LOG) {
         // targetted log frequencies should be recalculated when either number
         // of bars or graph start frequency change
         if (m_last_bar_count != number_of_bars || m_last_log_freq_start != m_cfg->log_freq_start) {
@@ -502,20 +775,31 @@ void spectrum_visualizer::create_spectrum_bars(fftw_complex *fftw_output, size_t
         }
     }
 
-    if (m_cfg->log_freq_scale) {
-        generate_log_bars(number_of_bars, fftw_results, fftw_output, m_fftw_magnitudes, *bars);
-    } else {
-        // Separate the frequency spectrum into bars, the number of bars is based on
-        // screen width
-        generate_bars(number_of_bars, fftw_results, m_low_cutoff_frequencies, m_high_cutoff_frequencies, fftw_output,
-                      bars);
+    {
+        PROFILE_SCOPE(m_cfg->profiler, stats::ST_BARS);
+        if (m_cfg->freq_scale == FS_CQT) {
+            generate_cqt_bars(number_of_bars, channel, *bars);
+        } else if (m_cfg->freq_scale == FS_LOG) {
+            generate_log_bars(number_of_bars, fftw_results, fftw_output, m_fftw_magnitudes, *bars);
+        } else {
+            // Separate the frequency spectrum into bars, the number of bars is based on
+            // screen width
+            generate_bars(number_of_bars, fftw_results, m_low_cutoff_frequencies, m_high_cutoff_frequencies,
+                          fftw_output, bars);
+        }
     }
 
     // smoothing
-    smooth_bars(bars);
+    {
+        PROFILE_SCOPE(m_cfg->profiler, stats::ST_SMOOTHING);
+        smooth_bars(bars);
+    }
 
     // scale bars
-    scale_bars(win_height, bars);
+    {
+        PROFILE_SCOPE(m_cfg->profiler, stats::ST_SCALING);
+        scale_bars(win_height, bars);
+    }
 
     // falloff, save values for next falloff run
     // falloff is only used in cli-visualizer
@@ -528,19 +812,17 @@ void spectrum_visualizer::recalculate_cutoff_frequencies(uint32_t number_of_bars
     auto freq_const =
         std::log10((m_cfg->low_cutoff_freq / m_cfg->high_cutoff_freq)) / ((1.0 / number_of_bars + 1.0) - 1.0);
 
-    (*low_cutoff_frequencies) = std::vector<uint32_t>(number_of_bars + 1);
-    (*high_cutoff_frequencies) = std::vector<uint32_t>(number_of_bars + 1);
-    (*freqconst_per_bin) = std::vector<double>(number_of_bars + 1);
-
+    /* Sized for number_of_bars + 1 in layout() */
     for (auto i = 0u; i <= number_of_bars; i++) {
         (*freqconst_per_bin)[i] =
             static_cast<double>(m_cfg->high_cutoff_freq) *
             std::pow(10.0, (freq_const * -1) + (((i + 1.0) / (number_of_bars + 1.0)) * freq_const));
 
-        auto frequency = (*freqconst_per_bin)[i] / (m_cfg->sample_rate / 2.0);
+        /* The rate and length of the decimated signal, if it is */
+        auto frequency = (*freqconst_per_bin)[i] / (m_fft_rate / 2.0);
 
         (*low_cutoff_frequencies)[i] =
-            static_cast<uint32_t>(std::floor(frequency * static_cast<double>(m_cfg->sample_size) / 4.0));
+            static_cast<uint32_t>(std::floor(frequency * static_cast<double>(m_fft_size) / 4.0));
 
         if (i > 0) {
             if ((*low_cutoff_frequencies)[i] <= (*low_cutoff_frequencies)[i - 1]) {
@@ -555,10 +837,6 @@ void spectrum_visualizer::generate_bars(uint32_t number_of_bars, size_t fftw_res
                                         const uint32v &low_cutoff_frequencies, const uint32v &high_cutoff_frequencies,
                                         const fftw_complex *fftw_output, doublev *bars) const
 {
-    if (bars->size() != number_of_bars) {
-        bars->resize(number_of_bars, 0.0);
-    }
-
     for (auto i = 0u; i < number_of_bars; i++) {
         double freq_magnitude = 0.0;
         for (auto cutoff_freq = low_cutoff_frequencies[i];
@@ -577,34 +855,50 @@ void spectrum_visualizer::generate_bars(uint32_t number_of_bars, size_t fftw_res
 
 void spectrum_visualizer::recalculate_target_log_frequencies(uint32_t number_of_bars)
 {
-    if (m_bar_freq.size() != number_of_bars) {
-        m_bar_freq.resize(number_of_bars, 0.0);
-    }
-
     for (auto i = 0u; i < number_of_bars; i++) {
         m_bar_freq[i] = logspace(m_cfg->log_freq_start, m_cfg->high_cutoff_freq, i, number_of_bars);
     }
 }
 
-void spectrum_visualizer::generate_log_bars(uint32_t number_of_bars, size_t fftw_results,
-                                            const fftw_complex *fftw_output, doublev &magnitudes, doublev &bars) const
+bool spectrum_visualizer::tune_bank(uint32_t number_of_bars)
 {
-    if (bars.size() != number_of_bars) {
-        bars.resize(number_of_bars, 0.0);
+    /* Mirrors the loops of generate_bars() and generate_log_bars(), both read the bins in ascending order */
+    bool fits = true;
+    m_bank.prepare(m_fft_size);
+    if (m_cfg->freq_scale == FS_LOG) {
+        if (m_last_bar_count != number_of_bars || m_last_log_freq_start != m_cfg->log_freq_start) {
+            recalculate_target_log_frequencies(number_of_bars);
+            m_last_log_freq_start = m_cfg->log_freq_start;
+            m_last_bar_count = number_of_bars;
+        }
+        for (uint32_t i = 0u; i < number_of_bars; i++) {
+            const int t = static_cast<int>(m_bar_freq[i] / m_cfg->high_cutoff_freq * number_of_bars);
+            for (int bin = UTIL_MAX(t - lanczos_window + 1, 0); bin < t + lanczos_window && bin < m_fftw_results; bin++)
+                fits &= m_bank.add(bin);
+        }
+        return fits;
     }
 
-    if (magnitudes.size() != fftw_results) {
-        magnitudes.resize(fftw_results, 0.0);
+    if (m_last_bar_count != number_of_bars) {
+        recalculate_cutoff_frequencies(number_of_bars, &m_low_cutoff_frequencies, &m_high_cutoff_frequencies,
+                                       &m_frequency_constants_per_bin);
+        m_last_bar_count = number_of_bars;
     }
+    for (uint32_t i = 0u; i < number_of_bars; i++) {
+        for (auto bin = m_low_cutoff_frequencies[i]; bin <= m_high_cutoff_frequencies[i] && bin < m_fftw_results; bin++)
+            fits &= m_bank.add(bin);
+    }
+    return fits;
+}
 
+void spectrum_visualizer::generate_log_bars(uint32_t number_of_bars, size_t fftw_results,
+                                            const fftw_complex *fftw_output, doublev &magnitudes, doublev &bars) const
+{
     for (uint32_t i = 0u; i < fftw_results; ++i) {
         magnitudes[i] = std::sqrt((fftw_output[i][0] * fftw_output[i][0]) + (fftw_output[i][1] * fftw_output[i][1]));
     }
 
-    // FIXME hardcoded to 3 for now
-    // look at visualizer_source.cpp: get_properties_for_visualiser()
     //const int lanczos_window = (m_cfg->log_freq_quality == LFQ_PRECISE) ? 3 : 2;
-    const int lanczos_window = 3;
     for (uint32_t i = 0u; i < number_of_bars; i++) {
         const double normalized_lin_bar = m_bar_freq[i] / m_cfg->high_cutoff_freq;
         const double t = normalized_lin_bar * number_of_bars;
@@ -634,4 +928,14 @@ void spectrum_visualizer::generate_log_bars(uint32_t number_of_bars, size_t fftw
     }
 }
 
+void spectrum_visualizer::generate_cqt_bars(uint32_t number_of_bars, size_t channel, doublev &bars) const
+{
+    m_cqt.magnitudes(channel, bars);
+
+    /* The kernels are normalized to their window length, scale them up to
+     * about what the fft bars produce, so the scale settings behave alike */
+    for (uint32_t i = 0u; i < number_of_bars; i++)
+        bars[i] = std::sqrt(bars[i] * m_cfg->sample_size * (100.0 / number_of_bars));
+}
+
 }
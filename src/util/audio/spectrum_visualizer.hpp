@@ -19,23 +19,34 @@
 #pragma once
 #include "../util.hpp"
 #include "audio_visualizer.hpp"
+#include "bar_export.hpp"
+#include "bar_stream.hpp"
+#include "constant_q.hpp"
+#include "decimator.hpp"
+#include "goertzel_bank.hpp"
+#include "vertex_buffer.hpp"
 #include <fftw3.h>
 #include <vector>
 
 #define DEAD_BAR_OFFSET 5 /* The last five bars seem to always be silent, so we cut them off */
 
-/* Save some writing */
-using doublev = std::vector<double>;
-using uint32v = std::vector<uint32_t>;
+/* Save some writing, all of these live in the arena */
+using doublev = audio::arena_array<double>;
+using uint32v = audio::arena_array<uint32_t>;
+using ringv = audio::arena_ring<double>;
 
 namespace audio {
 
 class spectrum_visualizer : public audio_visualizer {
     uint32_t m_last_bar_count;
     double m_last_log_freq_start;
-    bool m_sleeping = false;
-    float m_sleep_count = 0.f;
+    /* Silence gate, the fft is skipped while it is closed */
+    bool m_gate_open = true;
+    bool m_resting = false;   /* Bars settled at zero after the gate closed */
+    float m_gate_quiet = 0.f; /* Seconds the level has been below the close threshold */
     /* fft calculation vars */
+    size_t m_fft_size; /* Transform length, the sample size divided by the decimation factor */
+    double m_fft_rate; /* Sample rate of the transformed signal */
     size_t m_fftw_results;
     double *m_fftw_input_left;
     double *m_fftw_input_right;
@@ -46,35 +57,80 @@ class spectrum_visualizer : public audio_visualizer {
     fftw_complex *m_fftw_output_left;
     fftw_complex *m_fftw_output_right;
 
-    fftw_plan m_fftw_plan_left;
-    fftw_plan m_fftw_plan_right;
+    /* Batched plan for one or both channels, recreated in on_layout() */
+    fftw_plan m_fftw_plan;
+
+    /* Optionally downsamples the input in front of the fft */
+    decimator m_decimator;
+
+    /* Replaces the fft above if the frequency scale is FS_CQT */
+    constant_q m_cqt;
+
+    /* Replaces the fft above if there are few bars and it's cheaper, see on_layout() */
+    goertzel_bank m_bank;
+    bool m_use_bank = false;
+
+    /* Bars as of the last output_changed() call, rounded to pixels, left and right interleaved */
+    arena_array<int32_t> m_drawn_heights;
+
+    /* Optional copies of the bars for other processes, (re)opened in update() */
+    bar_export m_export;
+    bar_stream m_stream;
 
     /* Frequency cutoff variables */
     uint32v m_low_cutoff_frequencies;
     uint32v m_high_cutoff_frequencies;
     doublev m_frequency_constants_per_bin;
 
-    uint64_t m_silent_runs; /* determines sleep state */
-
-    bool prepare_fft_input(pcm_stereo_sample *buffer, uint32_t sample_size, double *fftw_input,
-                           channel_mode channel_mode);
+    /* Input level of one tick, in 16 bit sample units */
+    struct signal_level {
+        int32_t peak = 0;
+        int64_t energy = 0; /* Sum of squares */
+        size_t samples = 0;
+    };
+
+    /* Reads the audio and runs the silence gate, returns
+     * false if there's nothing to transform this tick */
+    bool read_input(float seconds);
+    /* Converts the pcm buffer to fft input, measures it and decimates it */
+    void prepare_input(signal_level &level);
+    /* Maps the transformed windows to bars */
+    void finish_bars();
+    void prepare_fft_input(pcm_stereo_sample *buffer, uint32_t sample_size, double *fftw_input,
+                           channel_mode channel_mode, signal_level &level);
+    /* Only measures, used while the gate is closed */
+    void measure_level(const pcm_stereo_sample *buffer, uint32_t sample_size, bool stereo, signal_level &level) const;
+    void update_gate(const signal_level &level, float seconds);
+    /* Lets the bars fall to rest while the gate is closed */
+    void settle_bars();
+    /* Splits the packed mid/side transform into the left and right output */
+    void unpack_mid_side();
+    /* Opens or closes the export and stream to match the settings */
+    void update_export();
+    /* Publishes the current bars to the export and stream, if they're open */
+    void export_bars();
 
     void create_spectrum_bars(fftw_complex *fftw_output, size_t fftw_results, int32_t win_height,
-                              uint32_t number_of_bars, doublev *bars);
+                              uint32_t number_of_bars, doublev *bars, size_t channel);
 
     void generate_bars(uint32_t number_of_bars, size_t fftw_results, const uint32v &low_cutoff_frequencies,
                        const uint32v &high_cutoff_frequencies, const fftw_complex *fftw_output, doublev *bars) const;
     void generate_log_bars(uint32_t number_of_bars, size_t fftw_results, const fftw_complex *fftw_output,
                            doublev &magnitudes, doublev &bars) const;
+    void generate_cqt_bars(uint32_t number_of_bars, size_t channel, doublev &bars) const;
 
     void recalculate_cutoff_frequencies(uint32_t number_of_bars, uint32v *low_cutoff_frequencies,
                                         uint32v *high_cutoff_frequencies, doublev *freqconst_per_bin);
     void recalculate_target_log_frequencies(uint32_t number_of_bars);
+    /* Adds a filter for every bin the bars read, returns false if they didn't all fit */
+    bool tune_bank(uint32_t number_of_bars);
     void smooth_bars(doublev *bars);
     void apply_falloff(const doublev &bars, doublev *falloff_bars) const;
-    void calculate_moving_average_and_std_dev(double new_value, size_t max_number_of_elements, doublev *old_values,
+    /* Number of max heights the auto scaling averages over */
+    size_t scaling_window_size() const;
+    void calculate_moving_average_and_std_dev(double new_value, size_t max_number_of_elements, ringv *old_values,
                                               double *moving_average, double *std_dev) const;
-    void maybe_reset_scaling_window(double current_max_height, size_t max_number_of_elements, doublev *values,
+    void maybe_reset_scaling_window(double current_max_height, size_t max_number_of_elements, ringv *values,
                                     double *moving_average, double *std_dev);
     void scale_bars(int32_t height, doublev *bars);
     void sgs_smoothing(doublev *bars);
@@ -85,21 +141,30 @@ protected:
      * otherwise they're directly copied */
     doublev m_bars_left, m_bars_right, m_bars_left_new, m_bars_right_new;
     //    doublev m_bars_falloff_left, m_bars_falloff_right;
-    doublev m_previous_max_heights;
+    ringv m_previous_max_heights;
     doublev m_monstercat_smoothing_weights;
+    doublev m_sgs_scratch; /* Copy of the bars before each smoothing pass */
 
-    gs_vertbuffer_t *make_rounded_rectangle(float height);
+    /* Refills the index-th pooled vertex buffer with a rounded bar */
+    gs_vertbuffer_t *make_rounded_rectangle(size_t index, float height);
     float m_corner_radius = 0;
     std::vector<struct vec2> m_circle_points;
+    vertex_buffer *m_rounded_bars = nullptr;
+    size_t m_rounded_bar_count = 0;
+
+    void layout(arena &a) override;
+    void on_layout() override;
 
 public:
     explicit spectrum_visualizer(source::config *cfg);
 
     ~spectrum_visualizer() override;
 
-    virtual void update() override;
+    virtual void update(uint32_t dirty) override;
 
     void tick(float seconds) override;
+
+    bool output_changed() override;
 };
 
 }
@@ -0,0 +1,146 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "task_pool.hpp"
+#include "../util.hpp"
+#include <cstdlib>
+
+namespace audio {
+
+task_pool::task_pool()
+{
+    size_t count = std::thread::hardware_concurrency();
+    count = count > 1 ? count - 1 : 0;
+
+    const char *env = getenv("SPECTRALIZER_THREADS");
+    if (env && *env)
+        count = strtoul(env, nullptr, 10);
+    count = UTIL_MIN(count, constants::max_workers);
+
+    /* The submitting thread gets a queue too, that's where it helps out from */
+    m_queue_count = count + 1;
+    m_queues.reset(new queue[m_queue_count]);
+    for (size_t i = 0; i < m_queue_count; i++)
+        m_queues[i].tasks.reserve(constants::worker_queue_reserve);
+
+    for (size_t i = 0; i < count; i++)
+        m_threads.emplace_back(&task_pool::worker, this, i + 1);
+    info("Analyzing on %zu worker threads", count);
+}
+
+task_pool::~task_pool()
+{
+    stop();
+}
+
+void task_pool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_stop = true;
+    }
+    m_work.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+    /* Anything submitted from now on runs right away */
+    m_threads.clear();
+}
+
+task_pool &task_pool::instance()
+{
+    static task_pool pool;
+    return pool;
+}
+
+void task_pool::submit(task &t)
+{
+    if (m_threads.empty()) {
+        t.run(t.data);
+        return;
+    }
+
+    t.pending.store(true, std::memory_order_relaxed);
+    /* Counted before it's visible, a worker may take it right away and
+     * m_queued must never drop below the number of queued tasks */
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_queued++;
+    }
+
+    /* Spread over the worker queues, the first queue belongs to the waiting thread */
+    queue &q = m_queues[1 + m_next++ % m_threads.size()];
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(&t);
+    }
+    m_work.notify_one();
+}
+
+bool task_pool::run_one(size_t home)
+{
+    task *t = nullptr;
+    for (size_t i = 0; i < m_queue_count && !t; i++) {
+        queue &q = m_queues[(home + i) % m_queue_count];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty())
+            continue;
+        /* The owner takes the newest task, thieves the oldest one */
+        if (i == 0) {
+            t = q.tasks.back();
+            q.tasks.pop_back();
+        } else {
+            t = q.tasks.front();
+            q.tasks.erase(q.tasks.begin());
+        }
+    }
+    if (!t)
+        return false;
+
+    m_queued--;
+    t->run(t->data);
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        t->pending.store(false, std::memory_order_release);
+    }
+    m_done.notify_all();
+    return true;
+}
+
+void task_pool::worker(size_t index)
+{
+    while (!m_stop) {
+        if (run_one(index))
+            continue;
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_work.wait(lock, [this] { return m_stop || m_queued > 0; });
+    }
+}
+
+void task_pool::wait(task &t)
+{
+    while (t.pending.load(std::memory_order_acquire)) {
+        if (run_one(0))
+            continue;
+        /* Nothing left to steal, the task is running on a worker */
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_done.wait(lock, [&t] { return !t.pending.load(std::memory_order_acquire); });
+    }
+}
+
+}
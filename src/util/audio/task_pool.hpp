@@ -0,0 +1,84 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace audio {
+
+/* Shared pool that runs the analysis of every source next to the others
+ * instead of one after another on the video thread. Each worker has its own
+ * queue and steals from the others once it's empty, the thread waiting for
+ * a result helps out the same way. There's one worker less than there are
+ * cores, since the video thread works too, unless SPECTRALIZER_THREADS says
+ * otherwise. With zero workers tasks run right away on the submitting thread */
+class task_pool {
+public:
+    /* Owned by whoever submits it, it has to outlive its execution */
+    struct task {
+        void (*run)(void *) = nullptr;
+        void *data = nullptr;
+        std::atomic<bool> pending{false};
+    };
+
+private:
+    struct queue {
+        std::mutex mutex;
+        std::vector<task *> tasks;
+    };
+
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<queue[]> m_queues;
+    size_t m_queue_count = 0;
+    std::atomic<size_t> m_next{0}, m_queued{0};
+    std::atomic<bool> m_stop{false};
+
+    /* Sleeping workers wait for m_queued, waiting submitters for a finished task */
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_work, m_done;
+
+    task_pool();
+    /* Runs one queued task, the own queue first, returns false if all were empty */
+    bool run_one(size_t home);
+    void worker(size_t index);
+
+public:
+    ~task_pool();
+    task_pool(const task_pool &) = delete;
+    task_pool &operator=(const task_pool &) = delete;
+
+    static task_pool &instance();
+
+    size_t workers() const { return m_threads.size(); }
+
+    /* Joins the workers, called when the module is unloaded, joining
+     * threads from static destructors can deadlock on windows */
+    void stop();
+
+    void submit(task &t);
+    /* Returns once the task ran, runs queued tasks in the meantime */
+    void wait(task &t);
+};
+
+}
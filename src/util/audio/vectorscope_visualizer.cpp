@@ -0,0 +1,132 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#include "vectorscope_visualizer.hpp"
+#include "../../source/visualizer_source.hpp"
+
+namespace audio {
+
+vectorscope_visualizer::vectorscope_visualizer(source::config *cfg) : audio_visualizer(cfg) {}
+
+vectorscope_visualizer::~vectorscope_visualizer()
+{
+    if (m_trail) {
+        obs_enter_graphics();
+        gs_texrender_destroy(m_trail);
+        obs_leave_graphics();
+    }
+}
+
+void vectorscope_visualizer::update(uint32_t dirty)
+{
+    audio_visualizer::update(dirty);
+    /* Square, the source resets cx & cy on every update */
+    m_cfg->cx = m_cfg->bar_height;
+    m_cfg->cy = m_cfg->bar_height;
+}
+
+void vectorscope_visualizer::tick(float seconds)
+{
+    if (!m_cfg->buffer)
+        return;
+
+    audio_visualizer::tick(seconds);
+
+    /* Mid is (l + r) / sqrt(2), side (l - r) / sqrt(2), the scale
+     * keeps full scale in phase or out of phase signals inside */
+    PROFILE_SCOPE(m_cfg->profiler, stats::ST_INPUT);
+    const float half = m_cfg->cx / 2.f;
+    const float scale = half / 65536.f;
+    const pcm_stereo_sample *s = m_cfg->buffer;
+
+    m_points.begin();
+    for (size_t i = 0; i < m_cfg->sample_size; i++)
+        m_points.vertex2f(half + (s[i].l - s[i].r) * scale, half - (s[i].l + s[i].r) * scale);
+    m_fresh = true;
+}
+
+void vectorscope_visualizer::accumulate()
+{
+    const uint32_t size = m_cfg->cx;
+    gs_texrender_reset(m_trail);
+    if (!gs_texrender_begin(m_trail, size, size))
+        return;
+
+    if (m_trail_size != size) {
+        struct vec4 clear;
+        vec4_zero(&clear);
+        gs_clear(GS_CLEAR_COLOR, &clear, 0.f, 0);
+        m_trail_size = size;
+    }
+
+    gs_ortho(0.f, size, 0.f, size, -100.f, 100.f);
+    gs_blend_state_push();
+    gs_enable_blending(true);
+
+    gs_effect_t *solid = obs_get_base_effect(OBS_EFFECT_SOLID);
+    gs_eparam_t *color = gs_effect_get_param_by_name(solid, "color");
+
+    /* Fades the previous frames, the trail is multiplied with the alpha */
+    struct vec4 fade;
+    vec4_set(&fade, 0.f, 0.f, 0.f, m_cfg->gravity);
+    gs_effect_set_vec4(color, &fade);
+    gs_blend_function(GS_BLEND_ZERO, GS_BLEND_SRCALPHA);
+    while (gs_effect_loop(solid, "Solid"))
+        gs_draw_sprite(nullptr, 0, size, size);
+
+    /* All points of the frame in one draw */
+    gs_vertbuffer_t *points = m_points.end();
+    if (points) {
+        struct vec4 point;
+        vec4_from_rgba(&point, m_cfg->color);
+        gs_effect_set_vec4(color, &point);
+        gs_blend_function_separate(GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA, GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+        gs_load_vertexbuffer(points);
+        while (gs_effect_loop(solid, "Solid"))
+            gs_draw(GS_POINTS, 0, m_points.size());
+    }
+
+    gs_blend_state_pop();
+    gs_texrender_end(m_trail);
+}
+
+void vectorscope_visualizer::render(gs_effect_t *effect)
+{
+    UNUSED_PARAMETER(effect);
+    if (!m_trail)
+        m_trail = gs_texrender_create(GS_RGBA16F, GS_ZS_NONE);
+
+    /* Only once per frame, the source may be shown in more than one view */
+    if (m_fresh) {
+        accumulate();
+        m_fresh = false;
+    }
+
+    gs_texture_t *trail = gs_texrender_get_texture(m_trail);
+    if (!trail || !m_trail_size)
+        return;
+
+    /* The trail is premultiplied, the source blends like every other visualizer */
+    gs_effect_t *draw = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+    gs_effect_set_texture(gs_effect_get_param_by_name(draw, "image"), trail);
+    while (gs_effect_loop(draw, "DrawAlphaDivide"))
+        gs_draw_sprite(trail, 0, m_cfg->cx, m_cfg->cy);
+}
+
+}
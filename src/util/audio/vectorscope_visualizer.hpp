@@ -0,0 +1,47 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+#pragma once
+#include "audio_visualizer.hpp"
+#include "vertex_buffer.hpp"
+
+namespace audio {
+
+/* Stereo phase scope, every sample pair is a point with the mid signal going
+ * up and the side signal going sideways, so mono sits on the vertical line.
+ * The points are drawn into a texture that fades by blending, the gravity
+ * setting sets how much of the previous frame is kept */
+class vectorscope_visualizer : public audio_visualizer {
+    vertex_buffer m_points;            /* Filled by tick(), uploaded by the next render */
+    bool m_fresh = false;              /* New points that weren't drawn into the trail yet */
+    gs_texrender_t *m_trail = nullptr; /* Premultiplied, so the fade darkens and clears it alike */
+    uint32_t m_trail_size = 0;         /* The trail is cleared after it was resized */
+
+    void accumulate();
+
+public:
+    explicit vectorscope_visualizer(source::config *cfg);
+    ~vectorscope_visualizer() override;
+
+    void update(uint32_t dirty) override;
+    void tick(float seconds) override;
+    bool own_effect() const override { return true; }
+    void render(gs_effect_t *effect) override;
+};
+}
@@ -0,0 +1,73 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#include "vertex_buffer.hpp"
+#include <algorithm>
+#include <graphics/vec3.h>
+#include <obs.h>
+
+namespace audio {
+
+vertex_buffer::~vertex_buffer()
+{
+    if (m_vb) {
+        obs_enter_graphics();
+        gs_vertexbuffer_destroy(m_vb);
+        obs_leave_graphics();
+    }
+}
+
+gs_vertbuffer_t *vertex_buffer::end()
+{
+    if (m_verts.empty())
+        return nullptr;
+
+    struct gs_vb_data *data = m_vb ? gs_vertexbuffer_get_data(m_vb) : nullptr;
+    const bool uvs = !m_uvs.empty();
+
+    if (!data || data->num < m_verts.size() || data->num < m_capacity || (uvs && !data->num_tex)) {
+        gs_vertexbuffer_destroy(m_vb);
+        m_capacity = std::max(m_capacity, m_verts.size());
+        data = gs_vbdata_create();
+        data->num = m_capacity;
+        data->points = static_cast<struct vec3 *>(bzalloc(sizeof(struct vec3) * data->num));
+        if (uvs) {
+            data->num_tex = 1;
+            data->tvarray = static_cast<struct gs_tvertarray *>(bzalloc(sizeof(struct gs_tvertarray)));
+            data->tvarray->width = 2;
+            data->tvarray->array = bzalloc(sizeof(struct vec2) * data->num);
+        }
+        fill(data);
+        m_vb = gs_vertexbuffer_create(data, GS_DYNAMIC);
+        return m_vb;
+    }
+
+    fill(data);
+    gs_vertexbuffer_flush(m_vb);
+    return m_vb;
+}
+
+void vertex_buffer::fill(struct gs_vb_data *data) const
+{
+    /* The tail past size() keeps old vertices, callers only draw size() of them */
+    for (size_t i = 0; i < m_verts.size(); i++)
+        vec3_set(&data->points[i], m_verts[i].x, m_verts[i].y, 0.f);
+    if (!m_uvs.empty() && data->num_tex)
+        std::copy(m_uvs.begin(), m_uvs.end(), static_cast<struct vec2 *>(data->tvarray->array));
+}
+}
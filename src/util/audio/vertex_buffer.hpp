@@ -0,0 +1,84 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#pragma once
+
+#include <graphics/graphics.h>
+#include <graphics/vec2.h>
+#include <vector>
+
+namespace audio {
+
+/* Replacement for gs_render_start/gs_render_save that keeps the vertex
+ * buffer around and only uploads new vertices every frame. The buffer
+ * only grows, a frame with fewer vertices fills the front of it and
+ * draws size() of them, so after the first frame nothing is allocated */
+class vertex_buffer {
+    gs_vertbuffer_t *m_vb = nullptr;
+    std::vector<struct vec2> m_verts; /* Keeps its capacity between frames */
+    std::vector<struct vec2> m_uvs;   /* Texture coordinates, empty if vertex2f() was used */
+    size_t m_capacity = 0;            /* Vertices the next buffer is created with */
+
+    void fill(struct gs_vb_data *data) const;
+
+public:
+    vertex_buffer() = default;
+    vertex_buffer(const vertex_buffer &) = delete;
+    vertex_buffer &operator=(const vertex_buffer &) = delete;
+    ~vertex_buffer();
+
+    /* Sizes the buffer for the largest frame up front, for callers whose
+     * vertex count changes from frame to frame */
+    void reserve(size_t vertices)
+    {
+        m_verts.reserve(vertices);
+        m_uvs.reserve(vertices);
+        m_capacity = vertices;
+    }
+
+    void begin()
+    {
+        m_verts.clear();
+        m_uvs.clear();
+    }
+
+    void vertex2f(float x, float y)
+    {
+        struct vec2 v;
+        vec2_set(&v, x, y);
+        m_verts.push_back(v);
+    }
+
+    /* For effects that read TEXCOORD0, either all vertices of a frame have one or none */
+    void vertex2f(float x, float y, float u, float v)
+    {
+        vertex2f(x, y);
+        struct vec2 uv;
+        vec2_set(&uv, u, v);
+        m_uvs.push_back(uv);
+    }
+
+    /* Uploads the vertices, returns null if there were none */
+    gs_vertbuffer_t *end();
+
+    /* The buffer as of the last end(), for drawing it again unchanged */
+    gs_vertbuffer_t *buffer() const { return m_vb; }
+    size_t size() const { return m_verts.size(); }
+};
+
+}
@@ -23,9 +23,202 @@
 namespace audio {
 wire_visualizer::wire_visualizer(source::config *cfg) : spectrum_visualizer(cfg) {}
 
+wire_visualizer::~wire_visualizer()
+{
+    if (m_wire_effect) {
+        obs_enter_graphics();
+        gs_effect_destroy(m_wire_effect);
+        obs_leave_graphics();
+    }
+}
+
+bool wire_visualizer::own_effect() const
+{
+    return m_cfg->wire_mode == WM_SMOOTH && !m_effect_failed;
+}
+
+void wire_visualizer::update(uint32_t dirty)
+{
+    spectrum_visualizer::update(dirty);
+    if (dirty & (DIRTY_GEOMETRY | DIRTY_BARS))
+        build_basis();
+}
+
+void wire_visualizer::build_basis()
+{
+    /* Segments shorter than two pixels don't make the curve look any smoother */
+    const uint32_t pitch = m_cfg->bar_width + m_cfg->bar_space;
+    m_max_steps = 1;
+    while (m_max_steps < constants::wire_max_steps && m_max_steps * 4 <= pitch)
+        m_max_steps *= 2;
+
+    /* The points of s steps per bar start at (s - 1) * 4, for t = 1/s ... 1 */
+    m_basis.resize((m_max_steps * 2 - 1) * 4);
+    for (uint32_t steps = 1; steps <= m_max_steps; steps *= 2) {
+        float *b = &m_basis[(steps - 1) * 4];
+        for (uint32_t k = 1; k <= steps; k++, b += 4) {
+            float t = static_cast<float>(k) / steps, t2 = t * t, t3 = t2 * t;
+            b[0] = 2 * t3 - 3 * t2 + 1; /* Start value */
+            b[1] = t3 - 2 * t2 + t;     /* Start tangent */
+            b[2] = -2 * t3 + 3 * t2;    /* End value */
+            b[3] = t3 - t2;             /* End tangent */
+        }
+    }
+
+    /* Room for every bar subdivided as far as it goes, so neither the points
+     * nor the vertex buffers have to grow while the curve changes shape */
+    size_t points = 0;
+    if (m_cfg->wire_mode == WM_SMOOTH && m_cfg->detail > 1)
+        points = (m_cfg->detail - 1) * m_max_steps + 1;
+    m_curve.reserve(points);
+    for (auto &vb : m_verts)
+        vb.reserve(points * 2);
+}
+
+void wire_visualizer::tessellate(channel_mode cm)
+{
+    const doublev &bars = cm == CM_RIGHT ? m_bars_right : m_bars_left;
+    const size_t count = UTIL_MIN(static_cast<size_t>(m_cfg->detail), bars.size());
+    const float pitch = m_cfg->bar_width + m_cfg->bar_space;
+    const int32_t offset = m_cfg->stereo_space / 2;
+
+    /* Same baselines as the other modes, the right channel grows downwards */
+    float base = m_cfg->bar_height, sign = -1;
+    if (cm == CM_LEFT) {
+        base = m_cfg->bar_height / 2;
+    } else if (cm == CM_RIGHT) {
+        base = m_cfg->bar_height / 2 + offset * 2;
+        sign = 1;
+    }
+
+    auto y = [&](size_t i) { return base + sign * static_cast<float>(bars[i] > 1.0 ? bars[i] : 1.0); };
+    /* Fritsch-Butland tangents, flat at extrema, so the curve never overshoots the bars */
+    auto tangent = [&](size_t i) {
+        float before = i > 0 ? y(i) - y(i - 1) : y(i + 1) - y(i);
+        float after = i + 1 < count ? y(i + 1) - y(i) : before;
+        if (before * after <= 0)
+            return 0.f;
+        return 2 * before * after / (before + after);
+    };
+
+    m_curve.clear();
+    if (count < 2)
+        return;
+
+    struct vec2 p;
+    vec2_set(&p, 0, y(0));
+    m_curve.push_back(p);
+
+    float m1 = tangent(0);
+    for (size_t i = 0; i + 1 < count; i++) {
+        const float y0 = y(i), y1 = y(i + 1), m0 = m1, chord = y1 - y0;
+        m1 = tangent(i + 1);
+
+        /* The cubic strays at most 4/27 of the tangent errors from the chord,
+         * halving the segments quarters the distance */
+        float error = 4.f / 27.f * (fabsf(m0 - chord) + fabsf(m1 - chord));
+        uint32_t steps = 1;
+        while (steps < m_max_steps && error > constants::wire_tolerance) {
+            steps *= 2;
+            error /= 4;
+        }
+
+        const float *b = &m_basis[(steps - 1) * 4];
+        for (uint32_t k = 1; k <= steps; k++, b += 4) {
+            vec2_set(&p, (i + static_cast<float>(k) / steps) * pitch, b[0] * y0 + b[1] * m0 + b[2] * y1 + b[3] * m1);
+            m_curve.push_back(p);
+        }
+    }
+}
+
+gs_vertbuffer_t *wire_visualizer::make_smooth(channel_mode cm, bool feathered)
+{
+    tessellate(cm);
+    vertex_buffer &vb = m_verts[cm == CM_RIGHT ? 1 : 0];
+    vb.begin();
+
+    /* For wire.effect the strip reaches a pixel further, u is the distance from the curve */
+    const float half = m_cfg->wire_thickness / 2.f + (feathered ? 1.f : 0.f);
+    const size_t last = m_curve.size() - 1;
+    for (size_t i = 0; i < m_curve.size(); i++) {
+        const struct vec2 &prev = m_curve[i > 0 ? i - 1 : 0];
+        const struct vec2 &next = m_curve[i < last ? i + 1 : last];
+        const struct vec2 &cur = m_curve[i];
+
+        /* Miter between the two neighbouring segments, capped at twice the thickness in sharp corners */
+        struct vec2 dir, seg, normal;
+        vec2_sub(&dir, &next, &prev);
+        vec2_norm(&dir, &dir);
+        vec2_sub(&seg, i > 0 ? &cur : &next, &prev);
+        vec2_norm(&seg, &seg);
+        vec2_set(&normal, -dir.y, dir.x);
+        float length = half / UTIL_MAX(dir.x * seg.x + dir.y * seg.y, 0.5f);
+
+        if (feathered) {
+            vb.vertex2f(cur.x + normal.x * length, cur.y + normal.y * length, half, 0.f);
+            vb.vertex2f(cur.x - normal.x * length, cur.y - normal.y * length, -half, 0.f);
+        } else {
+            vb.vertex2f(cur.x + normal.x * length, cur.y + normal.y * length);
+            vb.vertex2f(cur.x - normal.x * length, cur.y - normal.y * length);
+        }
+    }
+    return vb.end();
+}
+
+bool wire_visualizer::load_effect()
+{
+    if (m_wire_effect || m_effect_failed)
+        return m_wire_effect;
+
+    char *file = obs_module_file("wire.effect");
+    char *errors = nullptr;
+    if (file)
+        m_wire_effect = gs_effect_create_from_file(file, &errors);
+
+    if (!m_wire_effect) {
+        warn("Couldn't load wire.effect, the smooth wire is drawn without anti-aliasing: %s",
+             errors ? errors : "file not found");
+        m_effect_failed = true;
+    }
+    bfree(errors);
+    bfree(file);
+    return m_wire_effect;
+}
+
+void wire_visualizer::draw_smooth()
+{
+    if (!load_effect())
+        return;
+
+    struct vec4 color;
+    vec4_from_rgba(&color, m_cfg->color);
+    gs_effect_set_vec4(gs_effect_get_param_by_name(m_wire_effect, "color"), &color);
+    gs_effect_set_float(gs_effect_get_param_by_name(m_wire_effect, "half_width"), m_cfg->wire_thickness / 2.f);
+
+    gs_vertbuffer_t *vb[2] = {make_smooth(m_cfg->stereo ? CM_LEFT : CM_BOTH, true), nullptr};
+    if (m_cfg->stereo)
+        vb[1] = make_smooth(CM_RIGHT, true);
+
+    /* Blending is off while the visualizer draws. The color is the same everywhere, so
+     * only the coverage is blended, where the strip folds over itself it adds up */
+    gs_blend_state_push();
+    gs_enable_blending(true);
+    gs_blend_function_separate(GS_BLEND_ONE, GS_BLEND_ZERO, GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+    while (gs_effect_loop(m_wire_effect, "Draw")) {
+        for (size_t i = 0; i < 2; i++) {
+            if (!vb[i])
+                continue;
+            gs_load_vertexbuffer(vb[i]);
+            gs_draw(GS_TRISTRIP, 0, m_verts[i].size());
+        }
+    }
+    gs_blend_state_pop();
+}
+
 gs_vertbuffer_t *wire_visualizer::make_thin(channel_mode cm)
 {
-    gs_render_start(true);
+    vertex_buffer &vb = m_verts[cm == CM_RIGHT ? 1 : 0];
+    vb.begin();
     size_t i = 0, pos_x = 0;
     int32_t height = 0;
     int32_t offset = 0;
@@ -42,7 +235,7 @@ gs_vertbuffer_t *wire_visualizer::make_thin(channel_mode cm)
             height = UTIL_MAX(static_cast<int32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, center + offset + height);
+            vb.vertex2f(pos_x, center + offset + height);
         }
     } else if (cm == CM_LEFT) {
         for (; i < UTIL_MIN(m_cfg->detail + 1, m_bars_left.size()); i++) {
@@ -50,7 +243,7 @@ gs_vertbuffer_t *wire_visualizer::make_thin(channel_mode cm)
             height = UTIL_MAX(static_cast<int32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, center - offset - height);
+            vb.vertex2f(pos_x, center - offset - height);
         }
     } else {
         for (; i < UTIL_MIN(m_cfg->detail + 1, m_bars_left.size()); i++) {
@@ -58,16 +251,17 @@ gs_vertbuffer_t *wire_visualizer::make_thin(channel_mode cm)
             height = UTIL_MAX(static_cast<int32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, m_cfg->bar_height - height);
+            vb.vertex2f(pos_x, m_cfg->bar_height - height);
         }
     }
 
-    return gs_render_save();
+    return vb.end();
 }
 
 gs_vertbuffer_t *wire_visualizer::make_thick(channel_mode cm)
 {
-    gs_render_start(true);
+    vertex_buffer &vb = m_verts[cm == CM_RIGHT ? 1 : 0];
+    vb.begin();
     size_t i = 0, pos_x = 0;
     int32_t height = 0;
     int32_t offset = 0;
@@ -84,8 +278,8 @@ gs_vertbuffer_t *wire_visualizer::make_thick(channel_mode cm)
             height = UTIL_MAX(static_cast<int32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, center + offset + height);
-            gs_vertex2f(pos_x, center + offset + height - m_cfg->wire_thickness);
+            vb.vertex2f(pos_x, center + offset + height);
+            vb.vertex2f(pos_x, center + offset + height - m_cfg->wire_thickness);
         }
     } else if (cm == CM_LEFT) {
         for (; i < UTIL_MIN(m_cfg->detail + 1, m_bars_left.size()); i++) {
@@ -93,8 +287,8 @@ gs_vertbuffer_t *wire_visualizer::make_thick(channel_mode cm)
             height = UTIL_MAX(static_cast<int32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, center - offset - height);
-            gs_vertex2f(pos_x, center - offset - height + m_cfg->wire_thickness);
+            vb.vertex2f(pos_x, center - offset - height);
+            vb.vertex2f(pos_x, center - offset - height + m_cfg->wire_thickness);
         }
     } else {
         for (; i < UTIL_MIN(m_cfg->detail + 1, m_bars_left.size()); i++) {
@@ -102,17 +296,18 @@ gs_vertbuffer_t *wire_visualizer::make_thick(channel_mode cm)
             height = UTIL_MAX(static_cast<int32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, m_cfg->bar_height - height);
-            gs_vertex2f(pos_x, m_cfg->bar_height - height + m_cfg->wire_thickness);
+            vb.vertex2f(pos_x, m_cfg->bar_height - height);
+            vb.vertex2f(pos_x, m_cfg->bar_height - height + m_cfg->wire_thickness);
         }
     }
-    return gs_render_save();
+    return vb.end();
 }
 
 gs_vertbuffer_t *wire_visualizer::make_filled(channel_mode cm)
 {
 
-    gs_render_start(true);
+    vertex_buffer &vb = m_verts[cm == CM_RIGHT ? 1 : 0];
+    vb.begin();
     size_t i = 0, pos_x = 0;
     int32_t height = 0;
     int32_t offset = 0;
@@ -129,8 +324,8 @@ gs_vertbuffer_t *wire_visualizer::make_filled(channel_mode cm)
             height = UTIL_MAX(static_cast<int32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, center + offset + height);
-            gs_vertex2f(pos_x, center + offset);
+            vb.vertex2f(pos_x, center + offset + height);
+            vb.vertex2f(pos_x, center + offset);
         }
     } else if (cm == CM_LEFT) {
         for (; i < UTIL_MIN(m_cfg->detail + 1, m_bars_left.size()); i++) {
@@ -138,8 +333,8 @@ gs_vertbuffer_t *wire_visualizer::make_filled(channel_mode cm)
             height = UTIL_MAX(static_cast<int32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, center - offset - height);
-            gs_vertex2f(pos_x, center - offset);
+            vb.vertex2f(pos_x, center - offset - height);
+            vb.vertex2f(pos_x, center - offset);
         }
     } else {
         for (; i < UTIL_MIN(m_cfg->detail + 1, m_bars_left.size()); i++) {
@@ -147,16 +342,17 @@ gs_vertbuffer_t *wire_visualizer::make_filled(channel_mode cm)
             height = UTIL_MAX(static_cast<int32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, m_cfg->bar_height - height);
-            gs_vertex2f(pos_x, m_cfg->bar_height);
+            vb.vertex2f(pos_x, m_cfg->bar_height - height);
+            vb.vertex2f(pos_x, m_cfg->bar_height);
         }
     }
-    return gs_render_save();
+    return vb.end();
 }
 
 gs_vertbuffer_t *wire_visualizer::make_filled_inverted(channel_mode cm)
 {
-    gs_render_start(true);
+    vertex_buffer &vb = m_verts[cm == CM_RIGHT ? 1 : 0];
+    vb.begin();
     size_t i = 0, pos_x = 0;
     uint32_t height = 0;
     int32_t offset = 0;
@@ -173,8 +369,8 @@ gs_vertbuffer_t *wire_visualizer::make_filled_inverted(channel_mode cm)
             height = UTIL_MAX(static_cast<uint32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, center + offset + height);
-            gs_vertex2f(pos_x, m_cfg->cx);
+            vb.vertex2f(pos_x, center + offset + height);
+            vb.vertex2f(pos_x, m_cfg->cx);
         }
     } else if (cm == CM_LEFT) {
         for (; i < m_bars_left.size() - DEAD_BAR_OFFSET; i++) {
@@ -182,8 +378,8 @@ gs_vertbuffer_t *wire_visualizer::make_filled_inverted(channel_mode cm)
             height = UTIL_MAX(static_cast<uint32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, center - offset - height);
-            gs_vertex2f(pos_x, 0);
+            vb.vertex2f(pos_x, center - offset - height);
+            vb.vertex2f(pos_x, 0);
         }
     } else {
         for (; i < m_bars_left.size() - DEAD_BAR_OFFSET; i++) {
@@ -191,18 +387,18 @@ gs_vertbuffer_t *wire_visualizer::make_filled_inverted(channel_mode cm)
             height = UTIL_MAX(static_cast<uint32_t>(round(val)), 1);
 
             pos_x = i * (m_cfg->bar_width + m_cfg->bar_space);
-            gs_vertex2f(pos_x, m_cfg->bar_height - height);
-            gs_vertex2f(pos_x, 0);
+            vb.vertex2f(pos_x, m_cfg->bar_height - height);
+            vb.vertex2f(pos_x, 0);
         }
     }
-    return gs_render_save();
+    return vb.end();
 }
 
 void wire_visualizer::render(gs_effect_t *e)
 {
     gs_vertbuffer_t *vb_left = nullptr, *vb_right = nullptr;
     enum gs_draw_mode m = GS_TRISTRIP;
-    uint32_t num_verts = 0;
+    uint32_t num_verts = 0, num_right = 0;
     channel_mode main = m_cfg->stereo ? CM_LEFT : CM_BOTH;
 
     switch (m_cfg->wire_mode) {
@@ -231,17 +427,32 @@ void wire_visualizer::render(gs_effect_t *e)
             vb_right = make_filled(CM_RIGHT);
         num_verts = m_cfg->detail * 2;
         break;
+    case WM_SMOOTH:
+        if (own_effect()) {
+            draw_smooth();
+            return;
+        }
+        /* The channels are subdivided separately, so their vertex counts differ */
+        vb_left = make_smooth(main, false);
+        num_verts = m_verts[0].size();
+        if (m_cfg->stereo) {
+            vb_right = make_smooth(CM_RIGHT, false);
+            num_right = m_verts[1].size();
+        }
+        break;
     }
 
-    gs_load_vertexbuffer(vb_left);
-    gs_draw(m, 0, num_verts);
+    if (m_cfg->wire_mode != WM_SMOOTH)
+        num_right = num_verts;
 
-    if (vb_right) {
-        gs_load_vertexbuffer(vb_right);
+    if (vb_left) {
+        gs_load_vertexbuffer(vb_left);
         gs_draw(m, 0, num_verts);
     }
 
-    gs_vertexbuffer_destroy(vb_left);
-    gs_vertexbuffer_destroy(vb_right);
+    if (vb_right) {
+        gs_load_vertexbuffer(vb_right);
+        gs_draw(m, 0, num_right);
+    }
 }
 }
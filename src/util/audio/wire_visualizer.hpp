@@ -21,14 +21,37 @@
 
 namespace audio {
 class wire_visualizer : public spectrum_visualizer {
+    vertex_buffer m_verts[2]; /* Left & right */
+
     gs_vertbuffer_t *make_thin(channel_mode cm);
     gs_vertbuffer_t *make_thick(channel_mode cm);
     gs_vertbuffer_t *make_filled(channel_mode cm);
     gs_vertbuffer_t *make_filled_inverted(channel_mode cm);
 
+    /* WM_SMOOTH, a monotone cubic through the bar values, subdivided more
+     * where it bends more and extruded along its normals. Its edges are
+     * anti-aliased by data/wire.effect */
+    std::vector<float> m_basis;       /* Hermite basis of every subdivision level, see build_basis() */
+    uint32_t m_max_steps = 1;         /* Most segments per bar, depends on the bar spacing */
+    std::vector<struct vec2> m_curve; /* Keeps its capacity between frames */
+
+    void build_basis();
+    void tessellate(channel_mode cm);
+    gs_vertbuffer_t *make_smooth(channel_mode cm, bool feathered);
+
+    gs_effect_t *m_wire_effect = nullptr;
+    bool m_effect_failed = false; /* Falls back to the solid effect without anti-aliasing */
+
+    bool load_effect();
+    void draw_smooth();
+
 public:
     explicit wire_visualizer(source::config *cfg);
+    ~wire_visualizer() override;
+
+    void update(uint32_t dirty) override;
 
+    bool own_effect() const override;
     void render(gs_effect_t *e) override;
 };
 }
@@ -0,0 +1,129 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#include "stats.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace stats {
+
+void ingest_health::add_latency(uint64_t ns)
+{
+    /* Exponential moving average, new values weigh 1/8 */
+    uint64_t old = latency.load();
+    latency.store(old ? old - old / 8 + ns / 8 : ns);
+}
+
+void ingest_health::format(std::string &out) const
+{
+    char text[256];
+    snprintf(text, sizeof(text),
+             "ticks %llu, underruns %llu, overruns %llu\n"
+             "dropped frames %llu, latency %.1f ms\n",
+             (unsigned long long)ticks.load(), (unsigned long long)underruns.load(),
+             (unsigned long long)overruns.load(), (unsigned long long)dropped_frames.load(), latency.load() / 1000000.0);
+    out.append(text);
+}
+
+void ingest_health::maybe_warn(const char *source_name)
+{
+    uint64_t now = os_gettime_ns();
+    if (now - last_check < constants::stats_log_interval)
+        return;
+
+    uint64_t t = ticks.load(), u = underruns.load(), o = overruns.load();
+    double window = double(t - last_ticks);
+
+    if (last_check && window > 0) {
+        if ((u - last_underruns) / window > constants::health_warn_ratio)
+            warn("'%s' is starved of audio, %llu of %llu ticks had no data", source_name,
+                 (unsigned long long)(u - last_underruns), (unsigned long long)(t - last_ticks));
+        if ((o - last_overruns) / window > constants::health_warn_ratio)
+            warn("'%s' can't keep up with audio, dropped buffered audio %llu times in %llu ticks", source_name,
+                 (unsigned long long)(o - last_overruns), (unsigned long long)(t - last_ticks));
+    }
+
+    last_check = now;
+    last_ticks = t;
+    last_underruns = u;
+    last_overruns = o;
+}
+
+}
+
+#ifdef SPECTRALIZER_PROFILER
+
+namespace stats {
+
+static const char *stage_names[ST_COUNT] = {"audio", "input", "fft", "bars", "smoothing", "scaling", "render"};
+
+bool rolling_window::summarize(uint64_t *min, uint64_t *avg, uint64_t *p99) const
+{
+    size_t count = m_count.load(std::memory_order_relaxed);
+    if (count == 0)
+        return false;
+
+    /* Sort a copy, this only happens when the summary is requested */
+    uint64_t sorted[window_size];
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sorted[i] = m_samples[i].load(std::memory_order_relaxed);
+        sum += sorted[i];
+    }
+
+    *min = *std::min_element(sorted, sorted + count);
+
+    size_t p99_index = (count * 99) / 100;
+    std::nth_element(sorted, sorted + p99_index, sorted + count);
+
+    *avg = sum / count;
+    *p99 = sorted[p99_index];
+    return true;
+}
+
+void profiler::format(std::string &out) const
+{
+    char line[128];
+    uint64_t min, avg, p99;
+
+    for (int i = 0; i < ST_COUNT; i++) {
+        if (!m_stages[i].summarize(&min, &avg, &p99))
+            continue;
+        snprintf(line, sizeof(line), "%-10s min %.3f ms, avg %.3f ms, p99 %.3f ms\n", stage_names[i], min / 1000000.0,
+                 avg / 1000000.0, p99 / 1000000.0);
+        out.append(line);
+    }
+}
+
+void profiler::maybe_log(const char *source_name)
+{
+    uint64_t now = os_gettime_ns();
+    if (now - m_last_summary < constants::stats_log_interval)
+        return;
+    m_last_summary = now;
+
+    std::string summary;
+    format(summary);
+    if (!summary.empty())
+        info("Timings for '%s':\n%s", source_name, summary.c_str());
+}
+
+}
+
+#endif
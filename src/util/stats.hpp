@@ -0,0 +1,130 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <util/platform.h>
+
+namespace stats {
+
+/* Counters for the audio feeding a visualizer. The capture callback of
+ * internal sources runs on the audio thread, hence the atomics */
+struct ingest_health {
+    std::atomic<uint64_t> ticks{0};          /* Attempts to read a window of audio */
+    std::atomic<uint64_t> underruns{0};      /* Ticks that didn't have enough audio */
+    std::atomic<uint64_t> overruns{0};       /* Times captured audio had to be thrown away */
+    std::atomic<uint64_t> dropped_frames{0}; /* Audio frames thrown away, per channel */
+    std::atomic<uint64_t> latency{0};        /* Smoothed capture to analysis time in ns, zero if unknown */
+
+    /* State of the last check for sustained trouble */
+    uint64_t last_check = 0, last_ticks = 0, last_underruns = 0, last_overruns = 0;
+
+    void add_latency(uint64_t ns);
+
+    /* Appends a human readable summary */
+    void format(std::string &out) const;
+
+    /* Warns if too many ticks under- or overran since the last check,
+     * which happens every constants::stats_log_interval */
+    void maybe_warn(const char *source_name);
+};
+
+}
+
+/* Per-stage timing of the hot path. Only compiled in if cmake was
+ * configured with -DENABLE_PROFILER=ON, otherwise PROFILE_SCOPE expands
+ * to nothing and none of the classes below exist */
+#ifdef SPECTRALIZER_PROFILER
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(profiler, stage) stats::scoped_timer PROFILE_CONCAT(profile_timer_, __LINE__)(profiler, stage)
+
+namespace stats {
+
+enum stage
+{
+    ST_AUDIO = 0, /* Reading from the audio source */
+    ST_INPUT,     /* Converting pcm samples to fft input */
+    ST_FFT,       /* Plan creation and execution */
+    ST_BARS,      /* Mapping fft bins to bars */
+    ST_SMOOTHING,
+    ST_SCALING,
+    ST_RENDER,
+    ST_COUNT
+};
+
+/* Keeps the last window_size samples of one stage. Written by the video
+ * thread, but the summary can be read from the ui thread at any time, so
+ * everything is a relaxed atomic, which compiles to plain loads and stores */
+class rolling_window {
+public:
+    static const size_t window_size = 256;
+
+private:
+    std::atomic<uint64_t> m_samples[window_size]{};
+    std::atomic<size_t> m_pos{0}, m_count{0};
+
+public:
+    void push(uint64_t ns)
+    {
+        size_t pos = m_pos.load(std::memory_order_relaxed);
+        size_t count = m_count.load(std::memory_order_relaxed);
+        m_samples[pos].store(ns, std::memory_order_relaxed);
+        m_pos.store((pos + 1) % window_size, std::memory_order_relaxed);
+        if (count < window_size)
+            m_count.store(count + 1, std::memory_order_relaxed);
+    }
+
+    /* Returns false if there are no samples yet */
+    bool summarize(uint64_t *min, uint64_t *avg, uint64_t *p99) const;
+};
+
+class profiler {
+    rolling_window m_stages[ST_COUNT];
+    uint64_t m_last_summary = 0;
+
+public:
+    void record(stage s, uint64_t ns) { m_stages[s].push(ns); }
+
+    /* Appends one line per stage with min/avg/p99 in milliseconds */
+    void format(std::string &out) const;
+
+    /* Writes the summary to the log every constants::stats_log_interval */
+    void maybe_log(const char *source_name);
+};
+
+class scoped_timer {
+    profiler &m_profiler;
+    stage m_stage;
+    uint64_t m_start;
+
+public:
+    scoped_timer(profiler &p, stage s) : m_profiler(p), m_stage(s), m_start(os_gettime_ns()) {}
+    ~scoped_timer() { m_profiler.record(m_stage, os_gettime_ns() - m_start); }
+};
+
+}
+
+#else
+#define PROFILE_SCOPE(profiler, stage)
+#endif
@@ -25,7 +25,11 @@ const visual_mode visual                                  = VM_BARS;
 const smooting_mode smoothing                             = SM_NONE;
 const uint32_t color                                      = 0xffffffff;
 
-const bool log_freq_scale = false;
+const enum freq_scale freq_scale                          = FS_LIN;
+const uint16_t filter_bank_bars                           = 64;
+const bool decimate                                       = false;
+const double gate_threshold                               = -70.0; /* dBFS */
+const double gate_hysteresis                              = 6.0; /* dB */
 const log_freq_qual log_freq_quality                      = LFQ_FAST;
 const double log_freq_start                               = 40.0;
 const bool log_freq_use_hpf                               = true;
@@ -59,16 +63,26 @@ const uint16_t bar_space                                  = 2,
                bar_height                                 = 100,
                bar_min_height                             = 5,
                corner_points                              = 5;
+const bool gpu_bars                                       = false;
 
 const uint16_t wire_thickness                             = 5;
 const enum wire_mode wire_mode                            = WM_THIN;
 
+const uint16_t spectrogram_history                        = 256; /* Frames */
+
 const char *fifo_path                                     = "/tmp/mpd.fifo";
+const char *shm_name                                      = ""; /* Derived from the source name */
+const char *stream_address                                = "127.0.0.1:7878";
 const char *audio_source                                  = "none";
 
 const bool use_auto_scale                                 = true;
 const double scale_boost                                  = 0.0;
 const double scale_size                                   = 1.0;
+
+const bool sync_to_video                                  = false;
+const uint16_t sync_lookahead                             = 50; /* ms */
+
+const downmix_mode downmix                                = DM_STEREO;
 }
 
 namespace constants {
@@ -78,5 +92,33 @@ const double auto_scaling_erase_percent                   = 0.75;
 /* Amount of deviation needed between short term and long
  * term moving max height averages to trigger an autoscaling reset */
 const double deviation_amount_to_reset                    = 1.0;
+/* How often statistics are written to the log in ns */
+const uint64_t stats_log_interval                         = 10000000000ull;
+/* Share of ticks that may under- or overrun before a warning is logged */
+const double health_warn_ratio                            = 0.1;
+const size_t cqt_max_window                               = 8192;
+const double cqt_kernel_threshold                         = 0.01;
+const double goertzel_cost                                = 4.0;
+const double decimation_margin                            = 2.0;
+const size_t decimation_max                               = 32;
+const size_t decimation_taps                              = 12;
+const float gate_hold                                     = 1.f;
+const size_t max_workers                                  = 64;
+const size_t worker_queue_reserve                         = 64;
+const size_t bar_chunk                                    = 64; /* Bars per vertex buffer */
+/* Largest distance in pixels between a smooth wire and its tessellation */
+const float wire_tolerance                                = 0.25f;
+const uint32_t wire_max_steps                             = 16; /* Segments per bar, a power of two */
+const int16_t scope_trigger_hysteresis                    = 256; /* ~-42 dBFS */
+const double meter_floor                                  = -70.0; /* dB, the bottom of the meter */
+const size_t stream_queue                                 = 4;
+const uint32_t stream_key_interval                        = 60;
+const size_t stream_max_datagram                          = 65507; /* Largest udp payload */
 }
 /* clang-format on */
+
+std::mutex &fftw_planner_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
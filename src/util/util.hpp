@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <mutex>
 #include <obs-module.h>
 #include <vector>
 
@@ -44,8 +45,14 @@
 #define T_MODE_BARS                     T_("Spectralizer.Mode.Bars")
 #define T_MODE_CIRCLE_BARS              T_("Spectralizer.Mode.Circle.Bars")
 #define T_MODE_WIRE                     T_("Spectralizer.Mode.Wire")
+#define T_MODE_SPECTROGRAM              T_("Spectralizer.Mode.Spectrogram")
+#define T_MODE_SCOPE                    T_("Spectralizer.Mode.Scope")
+#define T_MODE_VECTORSCOPE              T_("Spectralizer.Mode.Vectorscope")
+#define T_MODE_METER                    T_("Spectralizer.Mode.Meter")
+#define T_SPECTROGRAM_HISTORY           T_("Spectralizer.Spectrogram.History")
 #define T_STEREO                        T_("Spectralizer.Stereo")
 #define T_STEREO_SPACE                  T_("Spectralizer.Stereo.Space")
+#define T_MID_SIDE                      T_("Spectralizer.Stereo.MidSide")
 #define T_DETAIL                        T_("Spectralizer.Detail")
 #define T_REFRESH_RATE                  T_("Spectralizer.RefreshRate")
 #define T_AUDIO_SOURCE                  T_("Spectralizer.AudioSource")
@@ -76,9 +83,18 @@
 #define T_WIRE_MODE_THICK               T_("Spectralizer.Wire.Mode.Thick")
 #define T_WIRE_MODE_FILL                T_("Spectralizer.Wire.Mode.Fill")
 #define T_WIRE_MODE_FILL_INVERTED       T_("Spectralizer.Wire.Mode.Fill.Invert")
+#define T_WIRE_MODE_SMOOTH              T_("Spectralizer.Wire.Mode.Smooth")
 #define T_WIRE_MODE                     T_("Spectralizer.Wire.Mode")
 #define T_WIRE_THICKNESS                T_("Spectralizer.Wire.Thickness")
-#define T_LOG_FREQ_SCALE                T_("Spectralizer.LogFreqScale.Enable")
+#define T_FREQ_SCALE                    T_("Spectralizer.FreqScale")
+#define T_FILTER_BANK_BARS              T_("Spectralizer.FilterBankBars")
+#define T_HIGH_CUTOFF                   T_("Spectralizer.HighCutoff")
+#define T_DECIMATE                      T_("Spectralizer.Decimate")
+#define T_GATE_THRESHOLD                T_("Spectralizer.Gate.Threshold")
+#define T_GATE_HYSTERESIS               T_("Spectralizer.Gate.Hysteresis")
+#define T_FREQ_SCALE_LIN                T_("Spectralizer.FreqScale.Linear")
+#define T_FREQ_SCALE_LOG                T_("Spectralizer.FreqScale.Log")
+#define T_FREQ_SCALE_CQT                T_("Spectralizer.FreqScale.ConstantQ")
 #define T_LOG_FREQ_SCALE_QUAL           T_("Spectralizer.LogFreqScale.Quality")
 #define T_LOG_FREQ_SCALE_QUAL_FAST      T_("Spectralizer.LogFreqScale.Quality.Fast")
 #define T_LOG_FREQ_SCALE_QUAL_PRECISE   T_("Spectralizer.LogFreqScale.Quality.Precise")
@@ -92,12 +108,31 @@
 #define T_CORNER_ROUNDING               T_("Spectralizer.Corner.Rounding")
 #define T_CORNER_RADIUS                 T_("Spectralizer.Corner.Radius")
 #define T_CORNER_POINTS                 T_("Spectralizer.Corner.Points")
+#define T_GPU_BARS                      T_("Spectralizer.GpuBars")
+#define T_SHM_EXPORT                    T_("Spectralizer.Export")
+#define T_SHM_NAME                      T_("Spectralizer.Export.Name")
+#define T_STREAM                        T_("Spectralizer.Stream")
+#define T_STREAM_ADDRESS                T_("Spectralizer.Stream.Address")
+#define T_STREAM_WIDE                   T_("Spectralizer.Stream.Wide")
+#define T_STATS                         T_("Spectralizer.Stats")
+#define T_STATS_REFRESH                 T_("Spectralizer.Stats.Refresh")
+#define T_STATS_SHOW                    T_("Spectralizer.Stats.Show")
+#define T_SYNC_TO_VIDEO                 T_("Spectralizer.Sync")
+#define T_SYNC_LOOKAHEAD                T_("Spectralizer.Sync.Lookahead")
+#define T_DOWNMIX                       T_("Spectralizer.Downmix")
+#define T_DOWNMIX_STEREO                T_("Spectralizer.Downmix.Stereo")
+#define T_DOWNMIX_SUM_ALL               T_("Spectralizer.Downmix.SumAll")
+#define T_DOWNMIX_LFE                   T_("Spectralizer.Downmix.LFE")
+#define T_DOWNMIX_CHANNELS              T_("Spectralizer.Downmix.Channels")
+#define T_DOWNMIX_LEFT                  T_("Spectralizer.Downmix.Left")
+#define T_DOWNMIX_RIGHT                 T_("Spectralizer.Downmix.Right")
 
 #define S_EXPONENT_ENABLED              "boost_enabled"
 #define S_EXPONENT                      "boost"
 #define S_SOURCE_MODE                   "source_mode"
 #define S_STEREO                        "stereo"
 #define S_STEREO_SPACE                  "stereo_space"
+#define S_MID_SIDE                      "mid_side"
 #define S_DETAIL                        "detail"
 #define S_REFRESH_RATE                  "refresh_rate"
 #define S_AUDIO_SOURCE                  "audio_source"
@@ -119,7 +154,13 @@
 #define S_SCALE_SIZE                    "scale_size"
 #define S_WIRE_MODE                     "wire_mode"
 #define S_WIRE_THICKNESS                "wire_thickness"
-#define S_LOG_FREQ_SCALE                "log_freq_scale"
+#define S_FREQ_SCALE                    "freq_scale"
+#define S_FILTER_BANK_BARS              "filter_bank_bars"
+#define S_HIGH_CUTOFF                   "high_cutoff"
+#define S_DECIMATE                      "decimate"
+#define S_GATE_THRESHOLD                "gate_threshold"
+#define S_GATE_HYSTERESIS               "gate_hysteresis"
+#define S_LOG_FREQ_SCALE                "log_freq_scale" /* Replaced by S_FREQ_SCALE, only read to migrate */
 #define S_LOG_FREQ_SCALE_QUALITY        "log_freq_scale_quality"
 #define S_LOG_FREQ_SCALE_START          "log_freq_scale_start"
 #define S_LOG_FREQ_SCALE_USE_HPF        "log_freq_scale_use_hpf"
@@ -129,15 +170,30 @@
 #define S_CORNER_ROUNDING               "round_corners"
 #define S_CORNER_RADIUS                 "corner_radius"
 #define S_CORNER_POINTS                 "corner_points"
+#define S_GPU_BARS                      "gpu_bars"
+#define S_SPECTROGRAM_HISTORY           "spectrogram_history"
+#define S_SHM_EXPORT                    "shm_export"
+#define S_SHM_NAME                      "shm_name"
+#define S_STREAM                        "stream"
+#define S_STREAM_ADDRESS                "stream_address"
+#define S_STREAM_WIDE                   "stream_wide"
+#define S_STATS                         "stats"
+#define S_STATS_REFRESH                 "stats_refresh"
+#define S_STATS_SHOW                    "stats_show"
+#define S_SYNC_TO_VIDEO                 "sync_to_video"
+#define S_SYNC_LOOKAHEAD                "sync_lookahead"
+#define S_DOWNMIX                       "downmix"
+#define S_DOWNMIX_LEFT                  "downmix_left"
+#define S_DOWNMIX_RIGHT                 "downmix_right"
 
 enum visual_mode
 {
-    VM_BARS, VM_CIRCULAR_BARS, VM_WIRE
+    VM_BARS, VM_CIRCULAR_BARS, VM_WIRE, VM_SPECTROGRAM, VM_SCOPE, VM_VECTORSCOPE, VM_METER
 };
 
 enum wire_mode
 {
-    WM_THIN, WM_THICK, WM_FILL, WM_FILL_INVERTED
+    WM_THIN, WM_THICK, WM_FILL, WM_FILL_INVERTED, WM_SMOOTH
 };
 
 enum smooting_mode
@@ -158,13 +214,25 @@ enum channel_mode
 {
     CM_LEFT = 0,
     CM_RIGHT,
-    CM_BOTH
+    CM_BOTH,
+    CM_MID_SIDE
 };
 
 enum freq_scale
 {
     FS_LIN = 0,
-    FS_LOG
+    FS_LOG, /* Linear fft bins resampled to a log scale */
+    FS_CQT  /* Constant-Q transform, see constant_q.hpp */
+};
+
+/* How the channels of an internal audio source are mixed
+ * into the left and right channel that are analyzed */
+enum downmix_mode
+{
+    DM_STEREO = 0, /* Front left & right */
+    DM_SUM_ALL,
+    DM_LFE,
+    DM_CHANNELS    /* Two channels picked by the user */
 };
 
 enum log_freq_qual
@@ -173,6 +241,19 @@ enum log_freq_qual
     LFQ_PRECISE,
 };
 
+/* Groups of settings, passed to the visualizers on update so they
+ * only rebuild what depends on the settings that actually changed */
+enum dirty_flags
+{
+    DIRTY_NONE = 0,
+    DIRTY_AUDIO = 1 << 0,    /* Audio source, sample rate, channel mixing, sync */
+    DIRTY_FFT = 1 << 1,      /* Stereo & mid/side layout of the fft */
+    DIRTY_BARS = 1 << 2,     /* Bar count, smoothing, scaling & frequency scale */
+    DIRTY_GEOMETRY = 1 << 3, /* Bar & wire dimensions, corners, circle layout */
+    DIRTY_COLOR = 1 << 4,    /* Values that are read every frame anyway */
+    DIRTY_ALL = 0xff
+};
+
 struct stereo_sample_frame
 {
     int16_t l, r;
@@ -186,7 +267,11 @@ namespace defaults {
     extern const smooting_mode  smoothing;
     extern const uint32_t       color;
 
-    extern const bool           log_freq_scale;
+    extern const enum freq_scale freq_scale;
+    extern const uint16_t       filter_bank_bars;
+    extern const bool           decimate;
+    extern const double         gate_threshold;  /* dBFS */
+    extern const double         gate_hysteresis; /* dB */
     extern const log_freq_qual  log_freq_quality;
     extern const double         log_freq_start;
     extern const bool           log_freq_use_hpf;
@@ -218,16 +303,26 @@ namespace defaults {
                                 bar_height,
                                 bar_min_height,
                                 corner_points;
+    extern const bool           gpu_bars;
 
     extern const uint16_t       wire_thickness;
     extern const enum wire_mode wire_mode;
 
+    extern const uint16_t       spectrogram_history;
+
     extern const char           *fifo_path;
+    extern const char           *shm_name;
+    extern const char           *stream_address;
     extern const char           *audio_source;
 
     extern const bool           use_auto_scale;
     extern const double         scale_boost;
     extern const double         scale_size;
+
+    extern const bool           sync_to_video;
+    extern const uint16_t       sync_lookahead;
+
+    extern const downmix_mode   downmix;
 };
 
 namespace constants {
@@ -237,6 +332,43 @@ namespace constants {
     /* Amount of deviation needed between short term and long
      * term moving max height averages to trigger an autoscaling reset */
     extern const double         deviation_amount_to_reset;
+    /* How often statistics are written to the log in ns */
+    extern const uint64_t       stats_log_interval;
+    /* Share of ticks that may under- or overrun before a warning is logged */
+    extern const double         health_warn_ratio;
+    /* Longest window of the constant-Q transform in samples, power of two */
+    extern const size_t         cqt_max_window;
+    /* Kernel values below this share of the peak of their bar are dropped */
+    extern const double         cqt_kernel_threshold;
+    /* Cost of one goertzel filter per sample, relative to the cost of an fft
+     * per sample and radix two pass, see goertzel_bank::cheaper_than_fft() */
+    extern const double         goertzel_cost;
+    /* The decimated nyquist frequency is kept at least this many times
+     * above the highest frequency, the filter rolls off in between */
+    extern const double         decimation_margin;
+    extern const size_t         decimation_max;
+    /* Filter length per unit of the decimation factor */
+    extern const size_t         decimation_taps;
+    /* Seconds the level has to stay below the gate before it closes */
+    extern const float          gate_hold;
+    /* Upper bound for the analysis threads */
+    extern const size_t         max_workers;
+    /* Initial capacity of each worker queue, one entry per source */
+    extern const size_t         worker_queue_reserve;
+    extern const size_t         bar_chunk;
+    extern const float          wire_tolerance;
+    extern const uint32_t       wire_max_steps;
+    extern const int16_t        scope_trigger_hysteresis;
+    extern const double         meter_floor;
+    /* Frames the bar stream buffers for its sender thread */
+    extern const size_t         stream_queue;
+    /* Delta frames the bar stream sends at most between two key frames */
+    extern const uint32_t       stream_key_interval;
+    extern const size_t         stream_max_datagram;
 }
 
 /* clang-format on */
+
+/* The fftw planner isn't thread safe and sources are destroyed on the ui
+ * thread, so every fftw_plan_* and fftw_destroy_plan call holds this */
+std::mutex &fftw_planner_mutex();
@@ -0,0 +1,553 @@
+/*************************************************************************
+ * This file is part of spectralizer
+ * github.con/univrsal/spectralizer
+ * Copyright 2020 univrsal <universailp@web.de>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************/
+
+
+/* Runs the visualizers without obs, ticking and rendering them every frame,
+ * and fails if the steady state allocates. The libobs functions they use
+ * are stubbed out below, the graphics objects are plain structs that keep
+ * what the checks need, and the audio comes from a generated signal. Every
+ * allocation through operator new, bmalloc and, with glibc, malloc is
+ * counted once the warm-up ticks after a layout are over, as is every
+ * vertex buffer, texture and texrender that's created */
+
+#include "../src/source/visualizer_source.hpp"
+#include "../src/util/audio/audio_source.hpp"
+#include "../src/util/audio/bar_visualizer.hpp"
+#include "../src/util/audio/circle_bar_visualizer.hpp"
+#include "../src/util/audio/meter_visualizer.hpp"
+#include "../src/util/audio/scope_visualizer.hpp"
+#include "../src/util/audio/spectrogram_visualizer.hpp"
+#include "../src/util/audio/vectorscope_visualizer.hpp"
+#include "../src/util/audio/wire_visualizer.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+static const int warm_up_ticks = 16, measured_ticks = 600;
+
+static std::atomic<bool> counting{false};
+static std::atomic<size_t> allocations{0};
+static size_t graphics_objects = 0; /* Created while counting */
+static size_t bad_draws = 0;        /* Past the end of the loaded buffer, or all of it */
+
+static void count()
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations++;
+}
+
+static void count_graphics_object()
+{
+    if (counting.load(std::memory_order_relaxed))
+        graphics_objects++;
+}
+
+#ifdef __GLIBC__
+/* Replacing malloc also catches allocations inside fftw and the standard library */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    count();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    count();
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    count();
+    return __libc_realloc(ptr, size);
+}
+
+static void *allocate(size_t size)
+{
+    return malloc(size);
+}
+#else
+static void *allocate(size_t size)
+{
+    count();
+    return malloc(size);
+}
+#endif
+
+void *operator new(size_t size)
+{
+    void *ptr = allocate(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+/* libobs */
+void blog(int log_level, const char *format, ...)
+{
+    if (log_level > LOG_WARNING)
+        return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+void *bmalloc(size_t size)
+{
+    return allocate(size ? size : 1);
+}
+
+void bfree(void *ptr)
+{
+    free(ptr);
+}
+
+uint64_t os_gettime_ns(void)
+{
+    static uint64_t now = 0;
+    return now += 1000000000 / 60;
+}
+
+char *obs_find_module_file(obs_module_t *, const char *file)
+{
+    char *path = static_cast<char *>(bmalloc(strlen(file) + 1));
+    strcpy(path, file);
+    return path;
+}
+
+obs_module_t *obs_current_module(void)
+{
+    return nullptr;
+}
+
+void obs_enter_graphics(void) {}
+
+void obs_leave_graphics(void) {}
+
+/* graphics */
+struct gs_vertex_buffer {
+    struct gs_vb_data *data;
+};
+
+struct gs_texture {
+    uint32_t width, height;
+};
+
+struct gs_texture_render {
+    gs_texture_t texture;
+};
+
+struct gs_effect {
+    bool looping;
+};
+
+static gs_vertbuffer_t *loaded_buffer = nullptr;
+static gs_effect_t base_effects[2];
+
+gs_effect_t *obs_get_base_effect(enum obs_base_effect effect)
+{
+    return &base_effects[effect == OBS_EFFECT_SOLID];
+}
+
+void vec2_norm(struct vec2 *dst, const struct vec2 *v)
+{
+    float length = sqrtf(v->x * v->x + v->y * v->y);
+    if (length > 0.f)
+        length = 1.f / length;
+    vec2_set(dst, v->x * length, v->y * length);
+}
+
+gs_vertbuffer_t *gs_vertexbuffer_create(struct gs_vb_data *data, uint32_t)
+{
+    count_graphics_object();
+    return new gs_vertex_buffer{data};
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vb)
+{
+    if (!vb)
+        return;
+    if (loaded_buffer == vb)
+        loaded_buffer = nullptr;
+    gs_vbdata_destroy(vb->data);
+    delete vb;
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *) {}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vb)
+{
+    return vb->data;
+}
+
+void gs_load_vertexbuffer(gs_vertbuffer_t *vb)
+{
+    loaded_buffer = vb;
+}
+
+void gs_draw(enum gs_draw_mode, uint32_t start_vert, uint32_t num_verts)
+{
+    /* Zero draws the whole buffer, including what's left past size() */
+    if (!loaded_buffer || num_verts == 0 || start_vert + num_verts > loaded_buffer->data->num)
+        bad_draws++;
+}
+
+void gs_draw_sprite(gs_texture_t *, uint32_t, uint32_t, uint32_t) {}
+
+void gs_matrix_push(void) {}
+
+void gs_matrix_pop(void) {}
+
+void gs_matrix_translate3f(float, float, float) {}
+
+void gs_matrix_rotaa4f(float, float, float, float) {}
+
+void gs_ortho(float, float, float, float, float, float) {}
+
+void gs_clear(uint32_t, const struct vec4 *, float, uint8_t) {}
+
+void gs_blend_state_push(void) {}
+
+void gs_blend_state_pop(void) {}
+
+void gs_enable_blending(bool) {}
+
+void gs_blend_function(enum gs_blend_type, enum gs_blend_type) {}
+
+void gs_blend_function_separate(enum gs_blend_type, enum gs_blend_type, enum gs_blend_type, enum gs_blend_type) {}
+
+gs_effect_t *gs_effect_create_from_file(const char *, char **)
+{
+    return new gs_effect{false};
+}
+
+void gs_effect_destroy(gs_effect_t *effect)
+{
+    delete effect;
+}
+
+gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *, const char *)
+{
+    return nullptr;
+}
+
+/* One pass per technique */
+bool gs_effect_loop(gs_effect_t *effect, const char *)
+{
+    effect->looping = !effect->looping;
+    return effect->looping;
+}
+
+void gs_effect_set_float(gs_eparam_t *, float) {}
+
+void gs_effect_set_vec2(gs_eparam_t *, const struct vec2 *) {}
+
+void gs_effect_set_vec4(gs_eparam_t *, const struct vec4 *) {}
+
+void gs_effect_set_texture(gs_eparam_t *, gs_texture_t *) {}
+
+gs_texture_t *gs_texture_create(uint32_t width, uint32_t height, enum gs_color_format, uint32_t, const uint8_t **,
+                                uint32_t)
+{
+    count_graphics_object();
+    return new gs_texture{width, height};
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+    delete tex;
+}
+
+void gs_texture_set_image(gs_texture_t *, const uint8_t *, uint32_t, bool) {}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+    return tex->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+    return tex->height;
+}
+
+gs_texrender_t *gs_texrender_create(enum gs_color_format, enum gs_zstencil_format)
+{
+    count_graphics_object();
+    return new gs_texture_render{{0, 0}};
+}
+
+void gs_texrender_destroy(gs_texrender_t *texrender)
+{
+    delete texrender;
+}
+
+void gs_texrender_reset(gs_texrender_t *) {}
+
+bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
+{
+    texrender->texture = {cx, cy};
+    return true;
+}
+
+void gs_texrender_end(gs_texrender_t *) {}
+
+gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
+{
+    return const_cast<gs_texture_t *>(&texrender->texture);
+}
+
+namespace audio {
+
+/* Two sines gliding through the spectrum, with a second of silence every ten
+ * seconds, so the gate closes and opens again */
+class test_source : public audio_source {
+    uint64_t m_frame = 0;
+    double m_phase[2] = {};
+
+public:
+    explicit test_source(source::config *cfg) : audio_source(cfg) {}
+
+    void update() override {}
+
+    bool tick(float) override
+    {
+        const bool silent = m_frame++ % 600 >= 540;
+        const double sweep = 0.5 + 0.5 * sin(m_frame * 0.01);
+        const double step[2] = {2 * M_PI * (40 + 8000 * sweep) / m_cfg->sample_rate,
+                                2 * M_PI * (3000 - 2500 * sweep) / m_cfg->sample_rate};
+        for (uint32_t i = 0; i < m_cfg->sample_size; i++) {
+            m_phase[0] += step[0];
+            m_phase[1] += step[1];
+            const double l = silent ? 0 : 12000 * sin(m_phase[0]) + 4000 * sin(m_phase[1]);
+            const double r = silent ? 0 : 6000 * sin(m_phase[0]) + 9000 * sin(m_phase[1]);
+            m_cfg->buffer[i].l = static_cast<int16_t>(l);
+            m_cfg->buffer[i].r = static_cast<int16_t>(r);
+        }
+        return true;
+    }
+};
+
+audio_source *audio_source::create(source::config *cfg)
+{
+    return new test_source(cfg);
+}
+
+}
+
+/* Same as visualizer_source::update() */
+static audio::audio_visualizer *create_visualizer(source::config &cfg)
+{
+    cfg.cx = UTIL_MAX(cfg.detail * (cfg.bar_width + cfg.bar_space) - cfg.bar_space, 10);
+    cfg.cy = UTIL_MAX(cfg.bar_height + (cfg.stereo ? cfg.stereo_space : 0), 10);
+    switch (cfg.visual) {
+    case VM_WIRE:
+        return new audio::wire_visualizer(&cfg);
+    case VM_CIRCULAR_BARS:
+        return new audio::circle_bar_visualizer(&cfg);
+    case VM_SPECTROGRAM:
+        return new audio::spectrogram_visualizer(&cfg);
+    case VM_SCOPE:
+        return new audio::scope_visualizer(&cfg);
+    case VM_VECTORSCOPE:
+        return new audio::vectorscope_visualizer(&cfg);
+    case VM_METER:
+        return new audio::meter_visualizer(&cfg);
+    default:
+        return new audio::bar_visualizer(&cfg);
+    }
+}
+
+/* Ticks and renders like visualizer_source, but draws every frame even if nothing moved */
+static bool frame(audio::audio_visualizer &visualizer)
+{
+    visualizer.tick(1 / 60.f);
+    const bool changed = visualizer.output_changed();
+    visualizer.render(visualizer.own_effect() ? nullptr : obs_get_base_effect(OBS_EFFECT_SOLID));
+    return changed;
+}
+
+struct scenario {
+    const char *name;
+    void (*setup)(source::config &cfg);
+};
+
+static const scenario scenarios[] = {
+    {"linear, monstercat", [](source::config &cfg) { cfg.smoothing = SM_MONSTERCAT; }},
+    {"linear, sgs, stereo",
+     [](source::config &cfg) {
+         cfg.smoothing = SM_SGS;
+         cfg.stereo = true;
+     }},
+    {"linear, fixed scale",
+     [](source::config &cfg) {
+         cfg.use_auto_scale = false;
+         cfg.sample_rate = 48000;
+         cfg.sample_size = 800;
+     }},
+    {"log, monstercat",
+     [](source::config &cfg) {
+         cfg.freq_scale = FS_LOG;
+         cfg.smoothing = SM_MONSTERCAT;
+     }},
+    {"log, mid & side, decimated",
+     [](source::config &cfg) {
+         cfg.freq_scale = FS_LOG;
+         cfg.stereo = cfg.mid_side = true;
+         cfg.decimate = true;
+         cfg.high_cutoff_freq = 8000;
+     }},
+    {"constant-q, stereo",
+     [](source::config &cfg) {
+         cfg.freq_scale = FS_CQT;
+         cfg.stereo = true;
+     }},
+    {"filter bank",
+     [](source::config &cfg) {
+         cfg.detail = 4;
+         cfg.filter_bank_bars = 8;
+     }},
+    {"bars, shader", [](source::config &cfg) { cfg.gpu_bars = true; }},
+    {"bars, rounded",
+     [](source::config &cfg) {
+         cfg.rounded_corners = true;
+         cfg.bar_width = 8;
+     }},
+    {"bars, rounded, stereo",
+     [](source::config &cfg) {
+         cfg.rounded_corners = cfg.stereo = true;
+         cfg.bar_width = 8;
+         cfg.stereo_space = 20;
+     }},
+    {"wire, thin", [](source::config &cfg) { cfg.visual = VM_WIRE; }},
+    {"wire, thick, stereo",
+     [](source::config &cfg) {
+         cfg.visual = VM_WIRE;
+         cfg.wire_mode = WM_THICK;
+         cfg.stereo = true;
+     }},
+    {"wire, filled",
+     [](source::config &cfg) {
+         cfg.visual = VM_WIRE;
+         cfg.wire_mode = WM_FILL;
+     }},
+    {"wire, filled inverted",
+     [](source::config &cfg) {
+         cfg.visual = VM_WIRE;
+         cfg.wire_mode = WM_FILL_INVERTED;
+     }},
+    {"wire, smooth",
+     [](source::config &cfg) {
+         cfg.visual = VM_WIRE;
+         cfg.wire_mode = WM_SMOOTH;
+         cfg.bar_space = 40;
+     }},
+    {"wire, smooth, stereo",
+     [](source::config &cfg) {
+         cfg.visual = VM_WIRE;
+         cfg.wire_mode = WM_SMOOTH;
+         cfg.stereo = true;
+         cfg.bar_space = 40;
+     }},
+    {"circle", [](source::config &cfg) { cfg.visual = VM_CIRCULAR_BARS; }},
+    {"circle, rounded",
+     [](source::config &cfg) {
+         cfg.visual = VM_CIRCULAR_BARS;
+         cfg.rounded_corners = true;
+         cfg.bar_width = 8;
+     }},
+    {"scope", [](source::config &cfg) { cfg.visual = VM_SCOPE; }},
+    {"vectorscope", [](source::config &cfg) { cfg.visual = VM_VECTORSCOPE; }},
+    {"meter", [](source::config &cfg) { cfg.visual = VM_METER; }},
+    {"spectrogram", [](source::config &cfg) { cfg.visual = VM_SPECTROGRAM; }},
+};
+
+int main()
+{
+    int failed = 0;
+    for (const scenario &s : scenarios) {
+        source::config cfg;
+        cfg.audio_source_name = "test";
+        s.setup(cfg);
+
+        audio::audio_visualizer *visualizer = create_visualizer(cfg);
+        visualizer->update(DIRTY_ALL);
+        for (int i = 0; i < warm_up_ticks; i++)
+            frame(*visualizer);
+
+        /* The output has to change, or the analysis didn't run at all */
+        int changed = 0;
+        allocations = 0;
+        graphics_objects = bad_draws = 0;
+        counting = true;
+        for (int i = 0; i < measured_ticks; i++)
+            changed += frame(*visualizer);
+        counting = false;
+        delete visualizer;
+
+        printf("%-28s %zu allocations, %zu graphics objects, %zu bad draws in %d frames, %d changed\n", s.name,
+               allocations.load(), graphics_objects, bad_draws, measured_ticks, changed);
+        if (allocations > 0 || graphics_objects > 0 || bad_draws > 0 || changed == 0)
+            failed++;
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}